@@ -0,0 +1,151 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <utility>
+#include <cstdint>
+#include <cassert>
+
+/* chunked arena addressed by 32 bit indices. The items of one allocation are
+   contiguous and items never move, so references stay valid while the arena
+   grows. There is no deallocation of single ranges, everything is released
+   at once. Blocks may also live in external memory, e.g. a mapped file. */
+template< typename T >
+class Arena
+{
+public:
+    static constexpr std::uint32_t none = std::uint32_t( -1 );
+    static constexpr size_t block_bits = 16;
+    static constexpr size_t block_size = size_t( 1 ) << block_bits;
+
+    // index of count contiguous items
+    std::uint32_t allocate( size_t count )
+    {
+        assert (count && count <= block_size);
+        if (blocks.empty() || counts.back() + count > capacity)
+        {
+            owned.emplace_back( new T[block_size] );
+            blocks.push_back( owned.back().get());
+            counts.push_back( 0 );
+            capacity = block_size;
+        }
+        const std::uint32_t idx = std::uint32_t( (blocks.size() - 1) << block_bits | counts.back());
+        counts.back() += std::uint32_t( count );
+        allocated += count;
+        return idx;
+    }
+
+    /* make room for the block table of the whole index space. The table does
+       not move anymore, so items are accessed while another thread allocates,
+       allocations have to be serialized. */
+    void reserve_blocks()
+    {
+        blocks.reserve( size_t( 1 ) << (32 - block_bits));
+    }
+
+    T& operator[]( std::uint32_t idx )
+    {
+        return blocks[idx >> block_bits][idx & (block_size - 1)];
+    }
+
+    T const& operator[]( std::uint32_t idx ) const
+    {
+        return blocks[idx >> block_bits][idx & (block_size - 1)];
+    }
+
+    // number of allocated items
+    size_t size() const
+    {
+        return allocated;
+    }
+
+    // heap bytes of the blocks, attached blocks are not counted
+    size_t bytes() const
+    {
+        return owned.size() * block_size * sizeof( T );
+    }
+
+    size_t block_count() const
+    {
+        return blocks.size();
+    }
+
+    T const* block( size_t idx ) const
+    {
+        return blocks[idx];
+    }
+
+    // items in use of the block, an attached block may hold less than block_size
+    size_t block_used( size_t idx ) const
+    {
+        return counts[idx];
+    }
+
+    // items in use of the last block
+    size_t last_used() const
+    {
+        return counts.empty() ? 0 : counts.back();
+    }
+
+    /* use block_count consecutive blocks at first as the arena, owner keeps
+       the memory alive. Only last_used items of the last block have to be
+       accessible, new items are allocated in new blocks. */
+    void attach( T* first, size_t block_count, size_t last_used, size_t allocated_items,
+                 std::shared_ptr< void > owner )
+    {
+        clear();
+        for (size_t idx = 0; idx != block_count; ++idx)
+            blocks.push_back( first + idx * block_size );
+        counts.assign( block_count, std::uint32_t( block_size ));
+        if (block_count)
+            counts.back() = std::uint32_t( last_used );
+        capacity = last_used;
+        allocated = allocated_items;
+        external = owner;
+    }
+
+    void clear()
+    {
+        blocks.clear();
+        owned.clear();
+        external.reset();
+        counts.clear();
+        capacity = block_size;
+        allocated = 0;
+    }
+
+    void swap( Arena& other )
+    {
+        std::swap( blocks, other.blocks );
+        std::swap( owned, other.owned );
+        std::swap( external, other.external );
+        std::swap( counts, other.counts );
+        std::swap( capacity, other.capacity );
+        std::swap( allocated, other.allocated );
+    }
+private:
+    std::vector< T* > blocks;
+    // blocks allocated by the arena
+    std::vector< std::unique_ptr< T[] > > owned;
+    // keeps attached blocks alive
+    std::shared_ptr< void > external;
+    // items in use per block
+    std::vector< std::uint32_t > counts;
+    // usable items of the last block
+    size_t capacity = block_size;
+    size_t allocated = 0;
+};
+
+// contiguous range of arena items, e.g. the children of a tree node
+template< typename T >
+struct Children
+{
+    T* begin() const { return first; }
+    T* end() const { return last; }
+    bool empty() const { return first == last; }
+    size_t size() const { return last - first; }
+    T& front() const { return *first; }
+
+    T* first = nullptr;
+    T* last = nullptr;
+};
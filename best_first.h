@@ -0,0 +1,138 @@
+#pragma once
+
+#include "minimax.h"
+
+#include <algorithm>
+
+/* best-first minimax on the vertex tree of a minimax search. Each step
+   descends from the root along the principal line, skipping children with
+   a proven value, expands the leaf at its end with evaluated children and
+   backs up the values on the way back. The tree grows where the principal
+   line goes, so forcing lines are searched much deeper than with iterative
+   deepening. All values are exact minimax values of the tree, the children
+   are kept sorted by value. The tree is the tree of the minimax search, so
+   it is reused after a move and can be inspected like a depth-first tree. */
+template< typename MoveT >
+struct BestFirst
+{
+    BestFirst( Minimax< MoveT >& minimax, size_t max_vertices ) : minimax( minimax ), max_vertices( max_vertices ) {}
+
+    // expand until max_vertices vertices are added or the root is decided
+    double operator()( Player player )
+    {
+        minimax.rec_count = 0;
+        minimax.vertex_count = 0;
+        max_ply = 0;
+
+        while (   minimax.vertices() < max_vertices && !minimax.root.is_terminal
+               && !minimax.stop)
+            descend( minimax.root, player, 0 );
+
+        return minimax.root.value();
+    }
+
+    // expand the most relevant leaf below vertex with player to move
+    void descend( Vertex< MoveT >& vertex, Player player, size_t ply )
+    {
+        ++minimax.rec_count;
+
+        if (!vertex.child_count)
+        {
+            expand( vertex, player );
+            max_ply = std::max( max_ply, ply );
+            return;
+        }
+
+        // a proven child cannot change, the first open child is the principal one
+        auto range = minimax.children( vertex );
+        auto principal = std::find_if( range.begin(), range.end(),
+            []( Vertex< MoveT > const& child ) { return !child.is_terminal; });
+        assert (principal != range.end());
+
+        minimax.rule->apply_move( principal->move, player );
+        descend( *principal, Player( -player ), ply + 1 );
+        minimax.rule->undo_move( principal->move, player );
+
+        back_up( vertex, player );
+    }
+
+    // generate and evaluate the children of a leaf
+    void expand( Vertex< MoveT >& vertex, Player player )
+    {
+        const Player winner = minimax.rule->get_winner();
+        if (winner != not_set)
+        {
+            set_terminal( vertex, winner * player1_won );
+            return;
+        }
+
+        auto& moves = minimax.rule->generate_moves();
+        if (moves.empty())
+        {
+            set_terminal( vertex, 0.0 );
+            return;
+        }
+
+        // mix in some randomness
+        minimax.g.shuffle( moves.begin(), moves.end());
+
+        assert (moves.size() <= 255);
+        const size_t bytes = minimax.arena.bytes();
+        vertex.children = minimax.arena.allocate( moves.size());
+        vertex.child_count = u_int8_t( moves.size());
+        minimax.add_bytes( minimax.arena.bytes() - bytes );
+        minimax.vertex_count += moves.size();
+        Vertex< MoveT >* child = &minimax.arena[vertex.children];
+        for (MoveT const& move : moves)
+            *child++ = Vertex< MoveT >( move );
+
+        // the moves are copied, the children may generate moves again
+        for (Vertex< MoveT >& child : minimax.children( vertex ))
+        {
+            minimax.rule->apply_move( child.move, player );
+            const Player child_winner = minimax.rule->get_winner();
+            if (child_winner != not_set)
+                set_terminal( child, child_winner * player1_won );
+            else
+            {
+                child.lower = child.upper = minimax.eval( *minimax.rule, Player( -player ));
+                child.depth = 0;
+            }
+            minimax.rule->undo_move( child.move, player );
+        }
+
+        back_up( vertex, player );
+    }
+
+    // minimax value of the children, proven if the best child wins or all are proven
+    void back_up( Vertex< MoveT >& vertex, Player player )
+    {
+        typename Minimax< MoveT >::Pred pred = player == player1 ? &Minimax< MoveT >::pred1 : &Minimax< MoveT >::pred2;
+        auto range = minimax.children( vertex );
+        Minimax< MoveT >::sort( range, pred );
+
+        Vertex< MoveT > const& best = range.front();
+        auto principal = std::find_if( range.begin(), range.end(),
+            []( Vertex< MoveT > const& child ) { return !child.is_terminal; });
+        if ((best.is_terminal && best.value() == player * player1_won) || principal == range.end())
+            set_terminal( vertex, best.value());
+        else
+        {
+            vertex.lower = vertex.upper = best.value();
+            // length of the principal line
+            vertex.depth = u_int8_t( std::min( size_t( principal->depth ) + 1, Minimax< MoveT >::max_vertex_depth - 1 ));
+        }
+    }
+
+    static void set_terminal( Vertex< MoveT >& vertex, double value )
+    {
+        vertex.lower = vertex.upper = value;
+        vertex.depth = Minimax< MoveT >::max_vertex_depth;
+        vertex.is_terminal = true;
+    }
+
+    Minimax< MoveT >& minimax;
+    const size_t max_vertices;
+    // deepest expanded leaf of the last search
+    size_t max_ply = 0;
+};
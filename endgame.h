@@ -0,0 +1,195 @@
+#pragma once
+
+#include "rule.h"
+#include "transposition.h"
+
+#include <functional>
+#include <algorithm>
+#include <optional>
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <cstdlib>
+
+/* exact win/draw/loss solver for positions with few empty cells left. Scores
+   are from the view of the side to move, a decided game scores win minus the
+   number of plies until the end, so the fastest win and the slowest loss are
+   preferred. The solver has its own transposition table, scores are stored
+   relative to the position. */
+template< typename MoveT >
+struct EndgameSolver
+{
+    typedef std::function< size_t (GenericRule< MoveT > const&) > EmptyCells;
+
+    static constexpr int win = 1000;
+    static constexpr size_t default_tt_bits = 20;
+
+    EndgameSolver( EmptyCells empty_cells, size_t threshold,
+                   std::shared_ptr< TranspositionTable< MoveT > > tt = nullptr )
+    : empty_cells( empty_cells ), threshold( threshold ),
+      tt( tt ? tt : std::make_shared< TranspositionTable< MoveT > >( default_tt_bits )) {}
+
+    // same settings and table but its own search state, e.g. for another thread
+    std::shared_ptr< EndgameSolver > fork() const
+    {
+        return std::make_shared< EndgameSolver >( empty_cells, threshold, tt );
+    }
+
+    bool applies( GenericRule< MoveT > const& rule ) const
+    {
+        return empty_cells( rule ) < threshold;
+    }
+
+    // plies until the game is decided, not meaningful for a draw
+    static size_t distance( int score )
+    {
+        return size_t( win - std::abs( score ));
+    }
+
+    /* exact score of the position for player to move, the best move is stored
+       in best_move. Returns nothing if stopped. */
+    std::optional< int > solve( GenericRule< MoveT >& rule, PositionKey< MoveT > const& from, Player player,
+                                std::atomic< bool > const& stop_flag )
+    {
+        stop = &stop_flag;
+        // only the last move of the line is relevant for the key
+        position.key = from.key;
+        position.line.clear();
+        if (!from.line.empty())
+            position.line.push_back( from.line.back());
+        moves.clear();
+        best_move.reset();
+
+        const int score = rec( rule, -win, win, player, 0 );
+        if (*stop)
+            return {};
+        return score;
+    }
+
+    int rec( GenericRule< MoveT >& rule, int alpha, int beta, Player player, size_t ply )
+    {
+        ++nodes;
+
+        if (*stop)
+            return 0;
+
+        // the previous move has decided the game
+        if (rule.get_winner() != not_set)
+            return -(win - int( ply ));
+
+        // no result can be better than winning with the next move
+        alpha = std::max( alpha, -(win - int( ply )));
+        beta = std::min( beta, win - int( ply ) - 1 );
+        if (ply && alpha >= beta)
+            return alpha;
+
+        // do not cut off at the root, we need the best move
+        std::optional< MoveT > tt_move;
+        if (auto entry = tt->probe( position.key ))
+        {
+            if (entry->has_move)
+                tt_move = entry->move;
+            const int value = from_tt( int( entry->value ), ply );
+            if (ply)
+            {
+                if (entry->bound == Exact)
+                    return value;
+                else if (entry->bound == LowerBound)
+                    alpha = std::max( alpha, value );
+                else
+                    beta = std::min( beta, value );
+                if (alpha >= beta)
+                    return value;
+            }
+        }
+        const int alpha_orig = alpha;
+
+        const size_t prev_size = moves.size();
+        {
+            auto& tmp = rule.generate_moves();
+            moves.insert( moves.end(), tmp.begin(), tmp.end());
+        }
+        const size_t new_size = moves.size();
+
+        // no moves left, draw
+        if (prev_size == new_size)
+            return 0;
+
+        // fastest win first, a move deciding the game now cannot be improved
+        for (size_t idx = prev_size; idx != new_size; ++idx)
+        {
+            rule.apply_move( moves[idx], player );
+            const bool won = rule.get_winner() != not_set;
+            rule.undo_move( moves[idx], player );
+            if (won)
+            {
+                if (!ply)
+                    best_move = moves[idx];
+                moves.resize( prev_size );
+                return win - int( ply ) - 1;
+            }
+        }
+
+        if (tt_move)
+        {
+            auto itr = std::find( moves.begin() + prev_size, moves.end(), *tt_move );
+            if (itr != moves.end())
+                std::rotate( moves.begin() + prev_size, itr, itr + 1 );
+        }
+
+        int value = -win;
+        size_t best = prev_size;
+        for (size_t idx = prev_size; idx != new_size; ++idx)
+        {
+            rule.apply_move( moves[idx], player );
+            position.apply_move( moves[idx], player );
+            const int new_value = -rec( rule, -beta, -alpha, Player( -player ), ply + 1 );
+            position.undo_move( moves[idx], player );
+            rule.undo_move( moves[idx], player );
+
+            if (new_value > value)
+            {
+                value = new_value;
+                best = idx;
+            }
+
+            alpha = std::max( alpha, value );
+            if (alpha >= beta)
+                break;
+        }
+
+        const MoveT best_move_of_node = moves[best];
+        moves.resize( prev_size );
+
+        if (!*stop)
+        {
+            if (!ply)
+                best_move = best_move_of_node;
+            tt->store( position.key, to_tt( value, ply ), &best_move_of_node, 0,
+                       value <= alpha_orig ? UpperBound : value >= beta ? LowerBound : Exact );
+        }
+
+        return value;
+    }
+
+    // the table stores distances to the end from the stored position
+    static int to_tt( int score, size_t ply )
+    {
+        return score > 0 ? score + int( ply ) : score < 0 ? score - int( ply ) : 0;
+    }
+
+    static int from_tt( int score, size_t ply )
+    {
+        return score > 0 ? score - int( ply ) : score < 0 ? score + int( ply ) : 0;
+    }
+
+    EmptyCells empty_cells;
+    const size_t threshold;
+    // may be shared with other solvers
+    std::shared_ptr< TranspositionTable< MoveT > > tt;
+    PositionKey< MoveT > position;
+    std::vector< MoveT > moves;
+    std::optional< MoveT > best_move;
+    std::atomic< bool > const* stop = nullptr;
+    size_t nodes = 0;
+};
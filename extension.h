@@ -0,0 +1,24 @@
+#pragma once
+
+#include "rule.h"
+
+#include <functional>
+
+/* search extensions for forcing moves. A forcing move is not counted against
+   the search depth as long as the extension budget of the line is not used
+   up. Without a forcing predicate nothing is extended. */
+template< typename MoveT >
+struct ForcingExtensions
+{
+    // true if the move, already applied to the rule, is forcing
+    typedef std::function< bool (GenericRule< MoveT > const&, MoveT const&) > IsForcing;
+
+    bool extends( GenericRule< MoveT > const& rule, MoveT const& move, size_t extended ) const
+    {
+        return extended < budget && is_forcing && is_forcing( rule, move );
+    }
+
+    IsForcing is_forcing;
+    // maximum number of extended plies along a line
+    size_t budget = 0;
+};
@@ -1,13 +1,19 @@
 #pragma once
 
 #include "negamax.h"
+#include "young_brothers_wait.h"
 #include "minimax.h"
+#include "parallel_minimax.h"
+#include "best_first.h"
 #include "montecarlo.h"
+#include "parallel_montecarlo.h"
 
 #include <iostream>
 #include <chrono>
 #include <memory>
 #include <future>
+#include <utility>
+#include <string>
 
 #include <cassert>
 
@@ -170,18 +176,25 @@ namespace montecarlo {
 template< typename MoveT >
 struct ChooseMove
 {
-    virtual Node< MoveT > const& operator()( NodeList< MoveT > const& nodes ) const = 0;
+    // player is to move at the root
+    virtual Node< MoveT > const& operator()( NodeRange< MoveT > const& nodes, Player player ) const = 0;
     virtual ~ChooseMove() {}
 };
 
 template< typename MoveT >
 struct ChooseBest : public ChooseMove< MoveT >
 {
-    Node< MoveT > const& operator()(NodeList< MoveT > const& nodes) const
+    // a proven win first and a proven loss last, else the most visited node
+    Node< MoveT > const& operator()(NodeRange< MoveT > const& nodes, Player player) const
     {
         assert (!nodes.empty());
-        return *max_element( nodes.begin(), nodes.end(),
-            [](auto& lhs, auto& rhs) { return lhs.denominator < rhs.denominator; });
+        auto rank = [player](Node< MoveT > const& node) 
+        {
+            const int proven = !node.is_terminal() || node.winner() == not_set ? 1 : node.winner() == player ? 2 : 0;
+            return std::make_pair( proven, node.denominator );
+        };
+        return *std::max_element( nodes.begin(), nodes.end(),
+            [&rank](auto& lhs, auto& rhs) { return rank( lhs ) < rank( rhs ); });
     }
 };
 
@@ -190,9 +203,15 @@ class Algorithm : public ::AlgorithmGenerics< MoveT >
 {
 public:
     Algorithm( GenericRule< MoveT > const& initial_rule, Player player, ChooseMove< MoveT >* choose_move, 
-               size_t simulations, double exploration ) :
+               size_t simulations, double exploration, size_t threads = 1, 
+               Parallelization parallelization = TreeParallelization, size_t leaf_batch = 1 ) :
         ::AlgorithmGenerics< MoveT >( player, initial_rule ), choose_move( choose_move ), simulations( simulations ),
-        mcts( initial_rule, exploration ) 
+        mcts( initial_rule, exploration ), 
+        tree_parallel( mcts, parallelization == TreeParallelization ? threads : 1 ),
+        root_parallel( mcts, parallelization == RootParallelization ? threads : 1 ), 
+        leaf_parallel( mcts, parallelization == LeafParallelization ? threads : 1, 
+                       parallelization == LeafParallelization ? leaf_batch : 1 ),
+        parallelization( parallelization )
     {}
 
     Node< MoveT > const& get_root()
@@ -204,39 +223,67 @@ public:
     {
         return mcts;
     }
+
+    /* continue with the tree saved for the initial position by an earlier
+       session, without a saved tree the tree of the first search is saved */
+    void use_tree_file( std::string const& path )
+    {
+        tree_file = path;
+        save_tree_file = !mcts.load( path );
+    }
 private:
     std::future< MoveT > get_future()
     {
         return std::async( 
             [this]() 
             {      
+                // the root parallel searches keep their trees too
                 if (this->next_move)
-                    mcts.apply_move( *this->next_move, this->player );           
+                    root_parallel.apply_move( *this->next_move, this->player );           
                 if (this->opp_move)
-                    mcts.apply_move( *this->opp_move, Player( -this->player ));
-
-                mcts( simulations, this->player );
-                return (*choose_move)( mcts.root.children).move;
+                    root_parallel.apply_move( *this->opp_move, Player( -this->player ));
+
+                if (parallelization == RootParallelization)
+                    root_parallel( simulations, this->player );
+                else if (parallelization == LeafParallelization)
+                    leaf_parallel( simulations, this->player );
+                else
+                    tree_parallel( simulations, this->player );
+                if (save_tree_file && mcts.position.line.empty())
+                    mcts.save( tree_file );
+                save_tree_file = false;
+                return (*choose_move)( root_parallel.children(), this->player ).move;
             });
     }
 
     void reset_impl()
     {
-        mcts.init( *this->initial_rule );
+        root_parallel.init( *this->initial_rule );
+        if (!tree_file.empty())
+            use_tree_file( tree_file );
     }
 
     void stop_impl() 
     {
         mcts.stop = true;
+        root_parallel.stop_helpers();
     }
 
     std::unique_ptr< ChooseMove< MoveT > > choose_move;
     size_t simulations;
     MCTS< MoveT > mcts;
+    TreeParallelMCTS< MoveT > tree_parallel;
+    RootParallelMCTS< MoveT > root_parallel;
+    LeafParallelMCTS< MoveT > leaf_parallel;
+    const Parallelization parallelization;
+    std::string tree_file;
+    bool save_tree_file = false;
 };
 
 } // namespace montecarlo {
 
+enum TreeSearch { DepthFirstSearch, BestFirstSearch };
+
 template< typename MoveT >
 class MinimaxAlgorithm : public AlgorithmGenerics< MoveT >
 {
@@ -244,8 +291,11 @@ public:
     MinimaxAlgorithm( GenericRule< MoveT > const& initial_rule, Player player,
                       std::function< double (GenericRule< MoveT >&, Player) > eval,
                       Recursion< MoveT >* recursion,
-                      std::function< MoveT const& (VertexList< MoveT > const&) > choose_move ) : 
+                      std::function< MoveT const& (VertexRange< MoveT > const&) > choose_move,
+                      size_t threads = 1, TreeSearch tree_search = DepthFirstSearch, 
+                      size_t best_first_vertices = 0 ) : 
         ::AlgorithmGenerics< MoveT >( player, initial_rule ), minimax( initial_rule, eval, *recursion ),
+        parallel( minimax, threads ), best_first( minimax, best_first_vertices ), tree_search( tree_search ),
         choose_move( choose_move ), recursion( recursion )
     {}
 
@@ -253,6 +303,19 @@ public:
     {
         return minimax.root;
     }
+
+    Minimax< MoveT >& get_minimax()
+    {
+        return minimax;
+    }
+
+    /* continue with the tree saved for the initial position by an earlier
+       session, without a saved tree the tree of the first search is saved */
+    void use_tree_file( std::string const& path )
+    {
+        tree_file = path;
+        save_tree_file = !minimax.load( path );
+    }
 private:
     std::future< MoveT > get_future()
     {
@@ -264,50 +327,159 @@ private:
                 if (this->opp_move)
                     minimax.apply_move( *this->opp_move, Player( -this->player ));
 
-                this->value = minimax( this->player );
+                if (tree_search == BestFirstSearch)
+                    this->value = best_first( this->player );
+                else
+                    this->value = parallel( this->player );
+                if (save_tree_file && minimax.position.line.empty())
+                    minimax.save( tree_file );
+                save_tree_file = false;
 
-                if (minimax.root.children.empty())
+                if (!minimax.root.child_count)
                     throw std::string( "no moves");
-                return choose_move( minimax.root.children );
+                return choose_move( std::as_const( minimax ).children( minimax.root ));
             });
     }
 
     void reset_impl()
     {
         minimax.rule->copy_from( *this->initial_rule );
-        minimax.root = Vertex< MoveT >( MoveT());
+        minimax.reset();
+        if (!tree_file.empty())
+            use_tree_file( tree_file );
     }
 
     void stop_impl() 
     {
         minimax.stop = true;
+        parallel.stop_helpers();
     }
 
     Minimax< MoveT > minimax;
-    std::function< MoveT const& (VertexList< MoveT > const&) > choose_move;
+    ParallelMinimax< MoveT > parallel;
+    BestFirst< MoveT > best_first;
+    const TreeSearch tree_search;
+    std::function< MoveT const& (VertexRange< MoveT > const&) > choose_move;
     std::unique_ptr< Recursion< MoveT > > recursion;
     double value = 0.0;
+    std::string tree_file;
+    bool save_tree_file = false;
 };
 
+enum ParallelSearch { LazySmpSearch, YoungBrothersWaitSearch };
+enum SearchStrategy { AlphaBetaStrategy, MtdfStrategy };
+
 template< typename MoveT >
 class NegamaxAlgorithm : public AlgorithmGenerics< MoveT >
 {
 public:
     NegamaxAlgorithm( GenericRule< MoveT > const& initial_rule, Player player, size_t depth,
-        ReOrder< MoveT > reorder, std::function< double (GenericRule< MoveT >&, Player) > eval ) : 
-        ::AlgorithmGenerics< MoveT >( player, initial_rule ), negamax( initial_rule, eval, reorder ), depth( depth ) {}
+        ReOrder< MoveT > reorder, std::function< double (GenericRule< MoveT >&, Player) > eval,
+        std::shared_ptr< ReorderByHistory< MoveT > > history = nullptr, size_t threads = 1,
+        ParallelSearch parallel_search = LazySmpSearch, size_t min_split_depth = 3,
+        SearchStrategy strategy = AlphaBetaStrategy, double mtdf_step = 1.0,
+        std::shared_ptr< EndgameSolver< MoveT > > endgame = nullptr, size_t pv_lines = 1 ) : 
+        ::AlgorithmGenerics< MoveT >( player, initial_rule ), negamax( initial_rule, eval, reorder, history ), 
+        lazy_smp( negamax, parallel_search == LazySmpSearch ? threads : 1 ), 
+        young_brothers_wait( negamax, parallel_search == YoungBrothersWaitSearch ? threads : 1, min_split_depth ),
+        mtdf( negamax, mtdf_step ), multi_pv( negamax, pv_lines ), parallel_search( parallel_search ), 
+        strategy( strategy ), depth( depth ) 
+    {
+        negamax.endgame = endgame;
+    }
+
+    Negamax< MoveT >& get_negamax()
+    {
+        return negamax;
+    }
+
+    YoungBrothersWaitStatistics const& get_young_brothers_wait_statistics() const
+    {
+        return young_brothers_wait.statistics;
+    }
+
+    Mtdf< MoveT > const& get_mtdf() const
+    {
+        return mtdf;
+    }
+
+    MultiPv< MoveT > const& get_multi_pv() const
+    {
+        return multi_pv;
+    }
+
+    // visited nodes of all search threads
+    size_t get_count() const
+    {
+        if (parallel_search == YoungBrothersWaitSearch)
+            return young_brothers_wait.statistics.nodes;
+        return lazy_smp.count();
+    }
+
+    // exact score of the last move if it was solved, see EndgameSolver
+    std::optional< int > get_proven_score() const
+    {
+        if (!proven)
+            return {};
+        return proven_score.load();
+    }
 private:
     std::future< MoveT > get_future()
     {
+        // before the launch, a stop arriving meanwhile is kept
+        young_brothers_wait.stop = false;
         return std::async( 
             [this]() 
             { 
                 if (this->next_move)
-                    negamax.rule->apply_move( *this->next_move, this->player );           
+                    negamax.apply_move( *this->next_move, this->player );           
                 if (this->opp_move)
-                    negamax.rule->apply_move( *this->opp_move, Player( -this->player ));
-
-                this->value = negamax( depth, this->player );
+                    negamax.apply_move( *this->opp_move, Player( -this->player ));
+                negamax.clear_statistics();
+
+                // hand over to the exact solver near the end of the game
+                proven = false;
+                auto& endgame = negamax.endgame;
+                if (endgame && endgame->applies( *negamax.rule ))
+                {
+                    const auto score = endgame->solve( *negamax.rule, negamax.position, this->player, negamax.stop );
+                    if (score && endgame->best_move)
+                    {
+                        proven_score = *score;
+                        proven = true;
+                        this->value = *score > 0 ? player1_won : *score < 0 ? player2_won : 0.0;
+                        return *endgame->best_move;
+                    }
+                }
+
+                // multi pv analysis searches on the main thread only
+                if (multi_pv.max_lines > 1)
+                {
+                    const auto lines = multi_pv( depth, this->player );
+                    if (lines.empty())
+                        throw std::string( "no moves");
+                    this->value = lines.front().value;
+                    return lines.front().pv.front();
+                }
+
+                // mtd(f) searches on the main thread only
+                if (strategy == MtdfStrategy)
+                {
+                    this->value = mtdf( depth, this->player );
+                    if (!mtdf.best_move)
+                        throw std::string( "no moves");
+                    return *mtdf.best_move;
+                }
+
+                if (parallel_search == YoungBrothersWaitSearch)
+                {
+                    this->value = young_brothers_wait( depth, this->player );
+                    if (!young_brothers_wait.best_move)
+                        throw std::string( "no moves");
+                    return *young_brothers_wait.best_move;
+                }
+
+                this->value = lazy_smp( depth, this->player );
 
                 if (negamax.moves.empty())
                     throw std::string( "no moves");
@@ -317,18 +489,27 @@ private:
 
     void reset_impl()
     {
-        negamax.rule->copy_from( *this->initial_rule );
-        negamax.moves.clear();
+        negamax.reset( *this->initial_rule );
     }
 
     void stop_impl() 
     { 
         negamax.stop = true; 
+        lazy_smp.stop_helpers();
+        young_brothers_wait.stop = true;
     }
 
     Negamax< MoveT > negamax;
+    LazySmp< MoveT > lazy_smp;
+    YoungBrothersWait< MoveT > young_brothers_wait;
+    Mtdf< MoveT > mtdf;
+    MultiPv< MoveT > multi_pv;
+    const ParallelSearch parallel_search;
+    const SearchStrategy strategy;
     size_t depth;
     double value = .0;
+    std::atomic< bool > proven = false;
+    std::atomic< int > proven_score = 0;
 };
 
 /*
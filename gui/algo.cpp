@@ -41,6 +41,8 @@ bool Algo::show_tree_controls(DropDownMenu& dropdown_menu)
         (prev_best_percentage != best_percentage.value);
 }
 
+void Algo::show_statistics() {}
+
 bool Algo::has_texture() const 
 { return tree_texture.operator bool(); }
 
@@ -129,12 +131,19 @@ void TicTacToeNegamax::show_side_panel(DropDownMenu& dropdown_menu)
     TicTacToeEval::show_side_panel( dropdown_menu);
 }
 
+EndgameSolver< tic_tac_toe::Move >::EmptyCells TicTacToeNegamax::get_empty_cells_function()
+{
+    return [](GenericRule< tic_tac_toe::Move > const& rule) 
+        { return tic_tac_toe::empty_cells( dynamic_cast< tic_tac_toe::Rule const& >( rule )); };
+}
+
 MetaTicTacToeNegamax::MetaTicTacToeNegamax( ::Player player ) 
     : Negamax< meta_tic_tac_toe::Move >( player ) {}
 
 void MetaTicTacToeNegamax::show_side_panel(DropDownMenu& dropdown_menu)
 {
     Negamax::show_side_panel( dropdown_menu);
+    show_forcing_extensions( dropdown_menu );
     MetaTicTacToeEval::show_side_panel( dropdown_menu );    
 }
 
@@ -142,7 +151,19 @@ function< double (GenericRule< meta_tic_tac_toe::Move >&, ::Player) >
     MetaTicTacToeNegamax::get_eval_function()
 { return MetaTicTacToeEval::get_eval_function(); }
 
-TicTacToeMinimax::TicTacToeMinimax( ::Player player ) : Minimax< tic_tac_toe::Move >( player ) {}
+EndgameSolver< meta_tic_tac_toe::Move >::EmptyCells MetaTicTacToeNegamax::get_empty_cells_function()
+{
+    return [](GenericRule< meta_tic_tac_toe::Move > const& rule) 
+        { return meta_tic_tac_toe::empty_cells( dynamic_cast< meta_tic_tac_toe::Rule const& >( rule )); };
+}
+
+ForcingExtensions< meta_tic_tac_toe::Move >::IsForcing MetaTicTacToeNegamax::get_forcing_function()
+{
+    return [](GenericRule< meta_tic_tac_toe::Move > const& rule, meta_tic_tac_toe::Move const& move) 
+        { return meta_tic_tac_toe::is_forcing( dynamic_cast< meta_tic_tac_toe::Rule const& >( rule ), move ); };
+}
+
+TicTacToeMinimax::TicTacToeMinimax( ::Player player ) : Minimax< tic_tac_toe::Move >( player, "ttt_minimax.tree" ) {}
 function< double (GenericRule< tic_tac_toe::Move >&, ::Player) > 
     TicTacToeMinimax::get_eval_function()
 {
@@ -156,7 +177,7 @@ void TicTacToeMinimax::build_tree( GVC_t* gv_gvc )
         throw std::runtime_error( "invalid algo (build_tree)");
 
     graphviz_tree.reset( new minimax::TicTacToeTree(
-        gv_gvc, player, m_algo->get_root()));
+        gv_gvc, player, m_algo->get_minimax()));
     reset_texture();
 }
 
@@ -172,24 +193,28 @@ Recursion< tic_tac_toe::Move >* TicTacToeMinimax::get_recursion_function()
         return new MaxDepth< tic_tac_toe::Move >( depth.value);
     else if (recursion_menu.selected == 1)
         return new MaxVertices< tic_tac_toe::Move > ( max_vertices.value );
+    else if (recursion_menu.selected == 2)
+        return new MaxMemory< tic_tac_toe::Move >( size_t( max_memory.value ) << 20 );
+    else if (recursion_menu.selected == 3)
+        return new MaxTime< tic_tac_toe::Move >( std::chrono::milliseconds( max_time.value ));
     else
         throw runtime_error( "invalid ttt recursion menu selection");
 }
 
-function< tic_tac_toe::Move const& (VertexList< tic_tac_toe::Move > const&) > TicTacToeMinimax::get_choose_move_function()
+function< tic_tac_toe::Move const& (VertexRange< tic_tac_toe::Move > const&) > TicTacToeMinimax::get_choose_move_function()
 {
     if (choose_menu.selected == 0)
         return bind( &ChooseFirst< tic_tac_toe::Move >::operator(), ChooseFirst< tic_tac_toe::Move >(), _1 );
     else if (choose_menu.selected == 1)
         return [cm = make_shared< ChooseMove< tic_tac_toe::Move > >( bucket_width.value)]
-            (VertexList< tic_tac_toe::Move > const& vertices)
+            (VertexRange< tic_tac_toe::Move > const& vertices)
             { return (*cm)( vertices ); };
     else
         throw runtime_error( "invalid ttt choose move menu selection");
 }
 
 MetaTicTacToeMinimax::MetaTicTacToeMinimax( ::Player player ) 
-    : Minimax< meta_tic_tac_toe::Move >( player) {}
+    : Minimax< meta_tic_tac_toe::Move >( player, "uttt_minimax.tree" ) {}
 
 function< double (GenericRule< meta_tic_tac_toe::Move >&, ::Player) > 
     MetaTicTacToeMinimax::get_eval_function()
@@ -204,41 +229,52 @@ void MetaTicTacToeMinimax::build_tree( GVC_t* gv_gvc )
         throw std::runtime_error( "invalid algo (build_tree)");
 
     graphviz_tree.reset( new minimax::MetaTicTacToeTree(
-        gv_gvc, player, m_algo->get_root()));
+        gv_gvc, player, m_algo->get_minimax()));
     reset_texture();
 }
 
 void MetaTicTacToeMinimax::show_side_panel(DropDownMenu& dropdown_menu)
 {
     Minimax< meta_tic_tac_toe::Move >::show_side_panel( dropdown_menu);
+    show_forcing_extensions( dropdown_menu );
     MetaTicTacToeEval::show_side_panel( dropdown_menu );
 }
 
+ForcingExtensions< meta_tic_tac_toe::Move >::IsForcing MetaTicTacToeMinimax::get_forcing_function()
+{
+    return [](GenericRule< meta_tic_tac_toe::Move > const& rule, meta_tic_tac_toe::Move const& move) 
+        { return meta_tic_tac_toe::is_forcing( dynamic_cast< meta_tic_tac_toe::Rule const& >( rule ), move ); };
+}
+
 Recursion< meta_tic_tac_toe::Move >* MetaTicTacToeMinimax::get_recursion_function()
 {
     if (recursion_menu.selected == 0)
         return new MaxDepth<meta_tic_tac_toe::Move >( depth.value);
     else if (recursion_menu.selected == 1)
         return new MaxVertices< meta_tic_tac_toe::Move >( max_vertices.value );
+    else if (recursion_menu.selected == 2)
+        return new MaxMemory< meta_tic_tac_toe::Move >( size_t( max_memory.value ) << 20 );
+    else if (recursion_menu.selected == 3)
+        return new MaxTime< meta_tic_tac_toe::Move >( std::chrono::milliseconds( max_time.value ));
     else
         throw runtime_error( "invalid uttt recursion menu selection");
 }
 
-function< meta_tic_tac_toe::Move const& (VertexList< meta_tic_tac_toe::Move > const&) > 
+function< meta_tic_tac_toe::Move const& (VertexRange< meta_tic_tac_toe::Move > const&) > 
     MetaTicTacToeMinimax::get_choose_move_function()
 {
     if (choose_menu.selected == 0)
         return bind( &ChooseFirst< meta_tic_tac_toe::Move >::operator(), ChooseFirst< meta_tic_tac_toe::Move >(), _1 );
     else if (choose_menu.selected == 1)
         return [cm = make_shared< ChooseMove< meta_tic_tac_toe::Move > >( bucket_width.value)]
-            (VertexList< meta_tic_tac_toe::Move > const& vertices)
+            (VertexRange< meta_tic_tac_toe::Move > const& vertices)
             { return (*cm)( vertices ); };
     else
         throw runtime_error( "invalid uttt choose move menu selection");
 }
 
 TicTacToeMontecarlo::TicTacToeMontecarlo( ::Player player ) 
-    : Montecarlo< tic_tac_toe::Move >( player, Menu { "choose", {"best"}}) {}
+    : Montecarlo< tic_tac_toe::Move >( player, Menu { "choose", {"best"}}, "ttt_montecarlo.tree" ) {}
 
 void TicTacToeMontecarlo::build_tree( GVC_t* gv_gvc )
 {
@@ -247,7 +283,7 @@ void TicTacToeMontecarlo::build_tree( GVC_t* gv_gvc )
         throw std::runtime_error( "invalid algo (build_tree)");
 
     graphviz_tree.reset( new montecarlo::TicTacToeTree(
-        gv_gvc, player, m_algo->get_mcts().exploration, m_algo->get_root()));
+        gv_gvc, player, m_algo->get_mcts().exploration, m_algo->get_mcts()));
     reset_texture();
 }
 
@@ -260,7 +296,7 @@ montecarlo::ChooseMove< tic_tac_toe::Move >* TicTacToeMontecarlo::get_choose_mov
 }
 
 MetaTicTacToeMontecarlo::MetaTicTacToeMontecarlo( ::Player player ) 
-    : Montecarlo< meta_tic_tac_toe::Move >( player, Menu { "choose", {"best"}}) {}
+    : Montecarlo< meta_tic_tac_toe::Move >( player, Menu { "choose", {"best"}}, "uttt_montecarlo.tree" ) {}
 
 void MetaTicTacToeMontecarlo::build_tree( GVC_t* gv_gvc )
 {
@@ -269,7 +305,7 @@ void MetaTicTacToeMontecarlo::build_tree( GVC_t* gv_gvc )
         throw std::runtime_error( "invalid algo (build_tree)");
 
     graphviz_tree.reset( new montecarlo::MetaTicTacToeTree(
-        gv_gvc, player, m_algo->get_mcts().exploration, m_algo->get_root()));
+        gv_gvc, player, m_algo->get_mcts().exploration, m_algo->get_mcts()));
     reset_texture();
 }
 
@@ -282,4 +318,30 @@ montecarlo::ChooseMove< meta_tic_tac_toe::Move >*
         throw runtime_error( "invalid uttt montecarlo choose move menu selection");
 }
 
+void MetaTicTacToeMontecarlo::show_side_panel(DropDownMenu& dropdown_menu)
+{
+    Montecarlo< meta_tic_tac_toe::Move >::show_side_panel( dropdown_menu );
+    show_playout_policy( dropdown_menu );
+}
+
+montecarlo::PlayoutPolicy< meta_tic_tac_toe::Move > MetaTicTacToeMontecarlo::get_playout_policy()
+{
+    typedef size_t (*Policy)( meta_tic_tac_toe::Rule const&, vector< meta_tic_tac_toe::Move > const&, ::Player, Random& );
+    Policy policy;
+    if (playout_menu.selected == 0)
+        return nullptr;
+    else if (playout_menu.selected == 1)
+        policy = meta_tic_tac_toe::playout::decisive;
+    else if (playout_menu.selected == 2)
+        policy = meta_tic_tac_toe::playout::anti_decisive;
+    else if (playout_menu.selected == 3)
+        policy = meta_tic_tac_toe::playout::weighted;
+    else
+        throw runtime_error( "invalid uttt playout policy menu selection");
+
+    return [policy](GenericRule< meta_tic_tac_toe::Move > const& rule, vector< meta_tic_tac_toe::Move > const& moves, 
+                    ::Player player, Random& gen)
+        { return policy( static_cast< meta_tic_tac_toe::Rule const& >( rule ), moves, player, gen ); };
+}
+
 } // namespace gui {
@@ -5,6 +5,8 @@
 
 #include "helper.h"
 
+#include <sstream>
+
 namespace gui {
 
 struct DropDownMenu;
@@ -30,6 +32,8 @@ public:
     virtual bool show_tree_controls(DropDownMenu&);
     virtual ChooseNodes* get_choose_best_count_nodes() = 0;
     virtual ChooseNodes* get_choose_best_percentage_nodes() = 0;
+    // show search statistics in the game info panel
+    virtual void show_statistics();
 protected:
     void reset();
 
@@ -103,7 +107,27 @@ public:
     virtual ~MMAlgo() {}
 protected:
     virtual std::function< double (GenericRule< MoveT >&, ::Player) > get_eval_function() = 0;
+    // no forcing moves by default
+    virtual typename ForcingExtensions< MoveT >::IsForcing get_forcing_function() { return nullptr; }
+    ForcingExtensions< MoveT > get_forcing_extensions()
+    {
+        ForcingExtensions< MoveT > forcing;
+        if (forcing_menu.selected == 1)
+        {
+            forcing.is_forcing = get_forcing_function();
+            forcing.budget = extension_budget.value;
+        }
+        return forcing;
+    }
+    void show_forcing_extensions(DropDownMenu& dropdown_menu)
+    {
+        dropdown_menu.add( forcing_menu );
+        if (forcing_menu.selected == 1)
+            show_spinner( extension_budget );
+    }
     Spinner depth = Spinner( "depth", 7, 1, 15 );
+    Menu forcing_menu { "forcing extensions", {"off", "on"}, 0 };
+    Spinner extension_budget = Spinner( "extension budget", 2, 1, 10 );
 };
 
 class TicTacToeEval
@@ -132,36 +156,175 @@ public:
     Negamax( ::Player player ) : MMAlgo< MoveT >( player ) {}
     void start_game( GenericRule< MoveT >& rule )
     {
+        std::shared_ptr< ReorderByHistory< MoveT > > history;
+        if (reorder_menu.selected == HistoryIdx)
+            history = std::make_shared< ReorderByHistory< MoveT > >();
         negamax_algorithm = new NegamaxAlgorithm< MoveT >(
-            rule, this->player, this->depth.value, get_reorder_function(), get_eval_function());
+            rule, this->player, this->depth.value, get_reorder_function( history ), get_eval_function(),
+            history, threads.value, ParallelSearch( parallel_menu.selected ), min_split_depth.value,
+            SearchStrategy( strategy_menu.selected ), mtdf_step.value, 
+            endgame_menu.selected == OnIdx 
+                ? std::make_shared< EndgameSolver< MoveT > >( get_empty_cells_function(), endgame_cells.value )
+                : nullptr, pv_lines.value );
+        negamax_algorithm->get_negamax().pruning = get_forward_pruning();
+        negamax_algorithm->get_negamax().forcing = this->get_forcing_extensions();
         this->algorithm.reset( negamax_algorithm ); 
+        print_rule.reset( rule.clone());
     }
     void show_side_panel(DropDownMenu& dropdown_menu)
     {
         show_spinner( this->depth );
+        show_spinner( pv_lines );
+        dropdown_menu.add( strategy_menu );
+        if (strategy_menu.selected == MtdfStrategy)
+            show_float_value_box( mtdf_step );
+        else
+        {
+            show_spinner( threads );
+            dropdown_menu.add( parallel_menu );
+            if (parallel_menu.selected == YoungBrothersWaitSearch)
+                show_spinner( min_split_depth );
+        }
         dropdown_menu.add( reorder_menu );
+        dropdown_menu.add( lmr_menu );
+        if (lmr_menu.selected == OnIdx)
+        {
+            show_spinner( lmr_reduction );
+            show_spinner( lmr_full_moves );
+            show_spinner( lmr_min_depth );
+        }
+        dropdown_menu.add( futility_menu );
+        if (futility_menu.selected == OnIdx)
+        {
+            show_float_value_box( futility_margin );
+            show_spinner( futility_depth );
+        }
+        dropdown_menu.add( razoring_menu );
+        if (razoring_menu.selected == OnIdx)
+        {
+            show_float_value_box( razoring_margin );
+            show_spinner( razoring_depth );
+        }
+        dropdown_menu.add( endgame_menu );
+        if (endgame_menu.selected == OnIdx)
+            show_spinner( endgame_cells );
+    }
+    void show_statistics()
+    {
+        if (!this->algorithm)
+            return;
+        if (auto score = negamax_algorithm->get_proven_score())
+        {
+            // count the moves of the winner
+            const size_t moves = (EndgameSolver< MoveT >::distance( *score ) + 1) / 2;
+            show_label( "endgame", 
+                !*score ? "forced draw"
+                : ((*score > 0 ? "forced win in " : "forced loss in ") + std::to_string( moves )).c_str());
+        }
+        if (pv_lines.value > 1)
+        {
+            auto const& multi_pv = negamax_algorithm->get_multi_pv();
+            show_label( "pv depth", std::to_string( multi_pv.depth ).c_str());
+            size_t idx = 0;
+            for (auto const& line : multi_pv.get_lines())
+            {
+                std::ostringstream stream;
+                stream << line.value << ":";
+                for (MoveT const& move : line.pv)
+                {
+                    stream << " ";
+                    print_rule->print_move( stream, move );
+                }
+                show_label( ("pv " + std::to_string( ++idx )).c_str(), stream.str().c_str());
+            }
+        }
+        if (strategy_menu.selected == MtdfStrategy)
+        {
+            auto const& mtdf = negamax_algorithm->get_mtdf();
+            const size_t passes = mtdf.pass_count;
+            show_label( "mtd(f) passes", std::to_string( passes ).c_str());
+            show_label( "nodes per pass", std::to_string( passes ? mtdf.nodes / passes : 0 ).c_str());
+        }
+        else if (parallel_menu.selected == YoungBrothersWaitSearch)
+        {
+            auto const& statistics = negamax_algorithm->get_young_brothers_wait_statistics();
+            show_label( "nodes", std::to_string( statistics.nodes ).c_str());
+            show_label( "splits", std::to_string( statistics.splits ).c_str());
+            show_label( "tasks (aborted)", (std::to_string( statistics.tasks ) + " (" 
+                + std::to_string( statistics.aborted_tasks ) + ")").c_str());
+            show_label( "steals", std::to_string( statistics.steals ).c_str());
+        }
+        // of the main search thread
+        auto const& negamax = negamax_algorithm->get_negamax();
+        if (lmr_menu.selected == OnIdx)
+            show_label( "reductions (researches)", (std::to_string( negamax.reductions ) + " ("
+                + std::to_string( negamax.researches ) + ")").c_str());
+        if (futility_menu.selected == OnIdx || razoring_menu.selected == OnIdx)
+            show_label( "pruned", std::to_string( negamax.pruned ).c_str());
     }
     void build_tree( GVC_t* gv_gvc ) {}
     ChooseNodes* get_choose_best_count_nodes() { return nullptr; }
     ChooseNodes* get_choose_best_percentage_nodes() { return nullptr; }
 protected:
     NegamaxAlgorithm< MoveT >* negamax_algorithm = nullptr;
-    Menu reorder_menu { "reorder moves", {"shuffle", "reorder by score"}, 1 };
-    ReOrder< MoveT > get_reorder_function()
+    // the rule of the search is modified while it runs
+    std::unique_ptr< GenericRule< MoveT > > print_rule;
+    Spinner pv_lines = Spinner( "principal variations", 1, 1, 9 );
+    Menu strategy_menu { "search strategy", {"alpha beta", "mtd(f)"}, AlphaBetaStrategy };
+    ValueBoxFloat mtdf_step = ValueBoxFloat( "mtd(f) step", "1.0" );
+    Spinner threads = Spinner( "threads", 1, 1, 64 );
+    Menu parallel_menu { "parallel search", {"lazy smp", "young brothers wait"}, LazySmpSearch };
+    Spinner min_split_depth = Spinner( "min split depth", 3, 1, 15 );
+    enum SwitchIdx { OffIdx, OnIdx };
+    Menu lmr_menu { "late move reductions", {"off", "on"}, OffIdx };
+    Spinner lmr_reduction = Spinner( "lmr reduction", 1, 1, 5 );
+    Spinner lmr_full_moves = Spinner( "lmr full moves", 3, 1, 81 );
+    Spinner lmr_min_depth = Spinner( "lmr min depth", 3, 1, 15 );
+    Menu futility_menu { "futility pruning", {"off", "on"}, OffIdx };
+    ValueBoxFloat futility_margin = ValueBoxFloat( "futility margin", "9.0" );
+    Spinner futility_depth = Spinner( "futility depth", 2, 1, 15 );
+    Menu razoring_menu { "razoring", {"off", "on"}, OffIdx };
+    ValueBoxFloat razoring_margin = ValueBoxFloat( "razoring margin", "18.0" );
+    Spinner razoring_depth = Spinner( "razoring depth", 1, 1, 15 );
+    Menu endgame_menu { "endgame solver", {"off", "on"}, OffIdx };
+    Spinner endgame_cells = Spinner( "endgame empty cells", 16, 1, 81 );
+    ForwardPruning get_forward_pruning()
     {
-        if (reorder_menu.selected == 0)
+        ForwardPruning pruning;
+        pruning.late_move_reductions = lmr_menu.selected == OnIdx;
+        pruning.lmr_reduction = lmr_reduction.value;
+        pruning.lmr_full_moves = lmr_full_moves.value;
+        pruning.lmr_min_depth = lmr_min_depth.value;
+        pruning.futility_pruning = futility_menu.selected == OnIdx;
+        pruning.futility_margin = futility_margin.value;
+        pruning.futility_depth = futility_depth.value;
+        pruning.razoring = razoring_menu.selected == OnIdx;
+        pruning.razoring_margin = razoring_margin.value;
+        pruning.razoring_depth = razoring_depth.value;
+        return pruning;
+    }
+    enum ReorderIdx { ShuffleIdx, ReorderByScoreIdx, HistoryIdx };
+    Menu reorder_menu { "reorder moves", {"shuffle", "reorder by score", "history heuristic"}, 
+                        ReorderByScoreIdx };
+    ReOrder< MoveT > get_reorder_function( std::shared_ptr< ReorderByHistory< MoveT > > history )
+    {
+        if (reorder_menu.selected == ShuffleIdx)
             return [shuffle = std::make_shared< Shuffle< MoveT > >()]
                 (GenericRule< MoveT >& rule, auto player, auto begin, auto end) 
                 { (*shuffle)( rule, player, begin, end ); };
-        else if (reorder_menu.selected == 1)
+        else if (reorder_menu.selected == ReorderByScoreIdx)
             return [rbs = std::make_shared< ReorderByScore< MoveT > >( this->get_eval_function())]
                 (auto& rule, auto player, auto begin, auto end) 
                 { (*rbs)( rule, player, begin, end ); };
+        else if (reorder_menu.selected == HistoryIdx)
+            return [history](auto& rule, auto player, auto begin, auto end) 
+                { (*history)( rule, player, begin, end ); };
         else    
             throw std::runtime_error( "invalid reorder menu selection");
     } 
 
     virtual std::function< double (GenericRule< MoveT >&, ::Player) > get_eval_function() = 0;
+    virtual typename EndgameSolver< MoveT >::EmptyCells get_empty_cells_function() = 0;
 };
 
 class TicTacToeNegamax : public Negamax< tic_tac_toe::Move >, public TicTacToeEval
@@ -170,6 +333,7 @@ public:
     TicTacToeNegamax( ::Player );
 protected:
     std::function< double (GenericRule< tic_tac_toe::Move >&, ::Player) > get_eval_function();
+    EndgameSolver< tic_tac_toe::Move >::EmptyCells get_empty_cells_function();
     virtual void show_side_panel(DropDownMenu& dropdown_menu);
 };
 
@@ -180,20 +344,30 @@ public:
 protected:
     virtual void show_side_panel(DropDownMenu& dropdown_menu);
     std::function< double (GenericRule< meta_tic_tac_toe::Move >&, ::Player) > get_eval_function();
+    EndgameSolver< meta_tic_tac_toe::Move >::EmptyCells get_empty_cells_function();
+    ForcingExtensions< meta_tic_tac_toe::Move >::IsForcing get_forcing_function();
 };
 
 template< typename MoveT >
 class Minimax : public MMAlgo< MoveT >
 {
 public:
-    Minimax( ::Player player ) 
-    : MMAlgo< MoveT >( player ), 
-      recursion_menu( Menu { "recursion", {"max depth", "max vertices"}} ), 
+    Minimax( ::Player player, std::string const& tree_file ) 
+    : MMAlgo< MoveT >( player ), tree_file( tree_file ),
+      recursion_menu( Menu { "recursion", {"max depth", "max vertices", "max memory", "max time"}} ), 
       choose_menu( Menu { "choose", {"best", "epsilon bucket"}} ) {}
     void start_game( GenericRule< MoveT >& rule )
     {
         minimax_algorithm = new MinimaxAlgorithm< MoveT >(
-            rule, this->player, this->get_eval_function(), get_recursion_function(), get_choose_move_function());
+            rule, this->player, this->get_eval_function(), get_recursion_function(), get_choose_move_function(),
+            threads.value, TreeSearch( search_menu.selected ), max_vertices.value );
+        minimax_algorithm->get_minimax().forcing = this->get_forcing_extensions();
+        minimax_algorithm->get_minimax().transpositions = 
+            search_menu.selected == DepthFirstSearch && transpositions_menu.selected == 1;
+        minimax_algorithm->get_minimax().ordering = MoveOrdering( ordering_menu.selected );
+        minimax_algorithm->get_minimax().by_score.noise = ordering_noise.value;
+        if (opening_tree_menu.selected == 1)
+            minimax_algorithm->use_tree_file( tree_file );
         this->algorithm.reset( minimax_algorithm );
     }
 
@@ -218,7 +392,18 @@ public:
     }
 protected:
     Spinner max_vertices = Spinner( "max vertices", 280000, 1, 1000000 );
-    enum RecursionIdx { MaxDepthIdx, MaxVerticesIdx };
+    Spinner max_memory = Spinner( "max memory mb", 256, 1, 65536 );
+    Spinner max_time = Spinner( "max time ms", 1000, 1, 600000 );
+    Spinner threads = Spinner( "threads", 1, 1, 64 );
+    Menu search_menu { "search", {"depth first", "best first"}, DepthFirstSearch };
+    Menu transpositions_menu { "transpositions", {"off", "on"}, 0 };
+    Menu ordering_menu { "order new vertices", {"shuffle", "reorder by score", "history heuristic"}, 
+                         ShuffleOrdering };
+    ValueBoxFloat ordering_noise = ValueBoxFloat( "ordering noise", "0.0" );
+    // reuse the tree of the initial position saved by an earlier game
+    Menu opening_tree_menu { "opening tree", {"off", "on"}, 0 };
+    const std::string tree_file;
+    enum RecursionIdx { MaxDepthIdx, MaxVerticesIdx, MaxMemoryIdx, MaxTimeIdx };
     Menu recursion_menu;
     enum ChooseIdx { BestIdx, EpsilonBucketIdx };
     Menu choose_menu;
@@ -227,17 +412,36 @@ protected:
     
     virtual void show_side_panel(DropDownMenu& dropdown_menu)    
     {    
-        dropdown_menu.add( recursion_menu );
+        dropdown_menu.add( search_menu );
         dropdown_menu.add( choose_menu );
-        if (recursion_menu.selected == MaxVerticesIdx)
+        // best first search is limited by the vertices only
+        if (search_menu.selected == BestFirstSearch)
             show_spinner( max_vertices );
-        else if (recursion_menu.selected == MaxDepthIdx)
-            show_spinner( this->depth );
+        else
+        {
+            dropdown_menu.add( recursion_menu );
+            if (recursion_menu.selected == MaxVerticesIdx)
+                show_spinner( max_vertices );
+            else if (recursion_menu.selected == MaxDepthIdx)
+                show_spinner( this->depth );
+            else if (recursion_menu.selected == MaxMemoryIdx)
+                show_spinner( max_memory );
+            else if (recursion_menu.selected == MaxTimeIdx)
+                show_spinner( max_time );
+            dropdown_menu.add( ordering_menu );
+            if (ordering_menu.selected == ScoreOrdering)
+                show_float_value_box( ordering_noise );
+            dropdown_menu.add( transpositions_menu );
+            // the dag is searched on one thread
+            if (transpositions_menu.selected == 0)
+                show_spinner( threads );
+        }
         if (choose_menu.selected == EpsilonBucketIdx)
             show_float_value_box( bucket_width );
+        dropdown_menu.add( opening_tree_menu );
     }
     virtual Recursion< MoveT >* get_recursion_function() = 0;
-    virtual std::function< MoveT const& (VertexList< MoveT > const&) > get_choose_move_function() = 0;
+    virtual std::function< MoveT const& (VertexRange< MoveT > const&) > get_choose_move_function() = 0;
 };
 
 class TicTacToeMinimax : public Minimax< tic_tac_toe::Move >, public TicTacToeEval
@@ -250,7 +454,7 @@ protected:
     void show_side_panel(DropDownMenu& dropdown_menu);
 
     Recursion< tic_tac_toe::Move >* get_recursion_function();
-    std::function< tic_tac_toe::Move const& (VertexList< tic_tac_toe::Move > const&) > 
+    std::function< tic_tac_toe::Move const& (VertexRange< tic_tac_toe::Move > const&) > 
         get_choose_move_function();
 };
 
@@ -264,8 +468,9 @@ protected:
     void show_side_panel(DropDownMenu& dropdown_menu);
 
     Recursion< meta_tic_tac_toe::Move >* get_recursion_function();
+    ForcingExtensions< meta_tic_tac_toe::Move >::IsForcing get_forcing_function();
 
-    std::function< meta_tic_tac_toe::Move const& (VertexList< meta_tic_tac_toe::Move > const&) > 
+    std::function< meta_tic_tac_toe::Move const& (VertexRange< meta_tic_tac_toe::Move > const&) > 
         get_choose_move_function();
 };
 
@@ -273,16 +478,27 @@ template< typename MoveT >
 class Montecarlo : public AlgoGenerics< MoveT >
 {
 public:
-    Montecarlo( ::Player player, Menu const& choose_menu ) 
-    : AlgoGenerics< MoveT >( player ), choose_menu( choose_menu ) {}
+    Montecarlo( ::Player player, Menu const& choose_menu, std::string const& tree_file ) 
+    : AlgoGenerics< MoveT >( player ), choose_menu( choose_menu ), tree_file( tree_file ) {}
     void start_game( GenericRule< MoveT >& rule )
     {
-        this->algorithm.reset( new montecarlo::Algorithm< MoveT >(
+        montecarlo_algorithm = new montecarlo::Algorithm< MoveT >(
             rule, this->player, this->get_choose_move_function(), simulations.value, 
-            exploration_factor.value ));
+            exploration_factor.value, threads.value, montecarlo::Parallelization( parallel_menu.selected ),
+            leaf_batch.value );
+        montecarlo_algorithm->get_mcts().playout_policy = get_playout_policy();
+        if (opening_tree_menu.selected == 1)
+            montecarlo_algorithm->use_tree_file( tree_file );
+        this->algorithm.reset( montecarlo_algorithm );
     }
 protected:
     virtual montecarlo::ChooseMove< MoveT >* get_choose_move_function() = 0;
+    // random playouts without a policy of the game
+    virtual montecarlo::PlayoutPolicy< MoveT > get_playout_policy() { return nullptr; }
+    void show_playout_policy(DropDownMenu& dropdown_menu)
+    {
+        dropdown_menu.add( playout_menu );
+    }
 
     ChooseNodes* get_choose_best_count_nodes()
     {
@@ -308,11 +524,26 @@ protected:
         dropdown_menu.add( choose_menu );
         show_spinner( simulations );
         show_float_value_box( exploration_factor );
+        show_spinner( threads );
+        if (threads.value > 1)
+        {
+            dropdown_menu.add( parallel_menu );
+            if (parallel_menu.selected == montecarlo::LeafParallelization)
+                show_spinner( leaf_batch );
+        }
+        dropdown_menu.add( opening_tree_menu );
     }
     montecarlo::Algorithm< MoveT >* montecarlo_algorithm = nullptr;
     Menu choose_menu;
+    // reuse the tree of the initial position saved by an earlier game
+    Menu opening_tree_menu { "opening tree", {"off", "on"}, 0 };
+    const std::string tree_file;
     Spinner simulations = Spinner( "simulations", 100 /*80000*/, 1, 1000000 );
     ValueBoxFloat exploration_factor = ValueBoxFloat( "exploration factor", "0.40" );
+    Spinner threads = Spinner( "threads", 1, 1, 64 );
+    Menu parallel_menu { "parallelization", {"tree", "root", "leaf"}, montecarlo::TreeParallelization };
+    Spinner leaf_batch = Spinner( "playouts per leaf", 8, 1, 256 );
+    Menu playout_menu { "playout policy", {"random", "decisive", "anti-decisive", "weighted"}, 0 };
 };
 
 class TicTacToeMontecarlo : public Montecarlo< tic_tac_toe::Move >
@@ -330,7 +561,9 @@ public:
     MetaTicTacToeMontecarlo( ::Player );
     void build_tree( GVC_t* gv_gvc );
 protected:
+    void show_side_panel(DropDownMenu& dropdown_menu);
     montecarlo::ChooseMove< meta_tic_tac_toe::Move >* get_choose_move_function();
+    montecarlo::PlayoutPolicy< meta_tic_tac_toe::Move > get_playout_policy();
 };
 
 } // namespace gui {
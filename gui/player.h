@@ -53,6 +53,7 @@ public:
         stream << std::setfill( '0' ) << std::setw( 2 ) << min.quot << ":" 
                << std::setw( 2 ) << sec.quot << "." << std::setw( 1 ) << dsec;  
         show_label( "accumulated time", stream.str().c_str());
+        algos[algo_menu.selected]->show_statistics();
     }
 protected:
     std::unique_ptr< AlgoGenerics< MoveT > > algos[algo_count];
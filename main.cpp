@@ -2,7 +2,11 @@
 #include "game.h"
 #include "gui/raylib_interface.h"
 
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
 #include <fstream>
+#include <iostream>
 #include <vector>
 
 using namespace std;
@@ -53,7 +57,7 @@ void run_meta_tic_tac_toe()
     MaxDepth< Move > max_depth( 7 );
 
     ChooseFirst< Move > choose;
-    function< Move const& (VertexList< Move > const&) > choose_move =
+    function< Move const& (VertexRange< Move > const&) > choose_move =
         bind( &ChooseFirst< Move >::operator(), &choose, _1 );
 
     NegamaxAlgorithm< Move > algo1( initial_rule, player1, 7, reorder, eval, false );
@@ -140,8 +144,25 @@ void monte()
 }
 */
 
-int main()
+int main( int argc, char* argv[] )
 {
+    // a master seed makes the searches reproducible
+    if (argc > 1)
+    {
+        char* end = nullptr;
+        errno = 0;
+        const unsigned long long seed = strtoull( argv[1], &end, 10 );
+        // strtoull would accept a sign or leading blanks
+        if (argc > 2 || !isdigit( static_cast< unsigned char >( argv[1][0] )) || *end != '\0'
+            || errno == ERANGE)
+        {
+            cerr << "usage: " << argv[0] << " [seed]" << endl
+                 << "  seed: unsigned integer that makes the searches reproducible" << endl;
+            return 1;
+        }
+        set_master_seed( seed );
+    }
+
     gui::show();
     //run_meta_tic_tac_toe();
     //monte();
@@ -2,12 +2,14 @@
 
 #include <cstdlib>
 #include <cassert>
+#include <algorithm>
+#include <array>
 
 using namespace std;
 
 namespace meta_tic_tac_toe {
 
-std::vector< Move > Rule::moves;
+thread_local std::vector< Move > Rule::moves;
 
 Rule::Rule()
     : board {not_set},
@@ -161,6 +163,24 @@ void Rule::undo_move( Move const& move, Player)
         move_stack.pop_back();
 }
 
+size_t empty_cells( Rule const& rule )
+{
+    if (rule.get_winner() != not_set)
+        return 0;
+
+    size_t result = 0;
+    for (size_t idx = 0; idx != n * n; ++idx)
+        if (!rule.terminals[idx])
+            result += count( rule.board.begin() + idx * item_size, 
+                             rule.board.begin() + (idx + 1) * item_size, not_set );
+    return result;
+}
+
+bool is_forcing( Rule const& rule, Move move )
+{
+    return rule.meta_board[move / item_size] != not_set || rule.terminals[move % item_size];
+}
+
 namespace simple_estimate {
     double eval( Rule& rule, double factor )
     {
@@ -179,4 +199,115 @@ namespace simple_estimate {
     }
 } // namespace simple_estimate {
 
+namespace playout {
+namespace {
+
+// the lines of a board as masks of its cells
+constexpr std::array< u_int16_t, 8 > lines = { 0x007, 0x038, 0x1c0, 0x049, 0x092, 0x124, 0x111, 0x054 };
+
+// for each mask of owned cells the mask of the cells completing a line
+constexpr std::array< u_int16_t, 512 > completing = []()
+{
+    std::array< u_int16_t, 512 > result {};
+    for (size_t mask = 0; mask != result.size(); ++mask)
+        for (u_int16_t line : lines)
+        {
+            const u_int16_t missing = line & ~mask;
+            // exactly one cell missing
+            if (missing && !(missing & (missing - 1)))
+                result[mask] |= missing;
+        }
+    return result;
+}();
+
+u_int16_t cells( Player const* board, Player player )
+{
+    u_int16_t mask = 0;
+    for (size_t idx = 0; idx != item_size; ++idx)
+        mask |= u_int16_t( board[idx] == player ) << idx;
+    return mask;
+}
+
+enum Level { Decisive, AntiDecisive, Weighted };
+
+size_t choose( Rule const& rule, vector< Move > const& moves, Player player, Random& gen, Level level )
+{
+    assert (!moves.empty() && moves.size() <= 81);
+
+    const u_int16_t meta_own = cells( rule.meta_board, player );
+    std::array< u_int8_t, 81 > decisive;
+    std::array< u_int8_t, 81 > blocking;
+    std::array< u_int32_t, 81 > weights;
+    size_t decisive_count = 0;
+    size_t blocking_count = 0;
+    u_int32_t total = 0;
+
+    // the moves are grouped by inner board
+    size_t board = item_size;
+    u_int16_t own = 0;
+    u_int16_t opponent = 0;
+    for (size_t idx = 0; idx != moves.size(); ++idx)
+    {
+        const div_t p = div( moves[idx], item_size );
+        if (size_t( p.quot ) != board)
+        {
+            board = p.quot;
+            own = cells( rule.board.data() + board * item_size, player );
+            opponent = cells( rule.board.data() + board * item_size, Player( -player ));
+        }
+
+        const u_int16_t cell = u_int16_t( 1 << p.rem );
+        if (completing[own] & cell)
+        {
+            if (completing[meta_own] & (1 << board))
+                return idx;
+            decisive[decisive_count++] = u_int8_t( idx );
+        }
+        else if (level != Decisive && (completing[opponent] & cell))
+            blocking[blocking_count++] = u_int8_t( idx );
+        else if (level == Weighted)
+        {
+            u_int32_t weight = 1;
+            for (u_int16_t line : lines)
+                if ((line & cell) && !(line & opponent))
+                    weight += 1 + __builtin_popcount( line & own );
+            weights[idx] = weight;
+            total += weight;
+        }
+    }
+
+    if (decisive_count)
+        return decisive[gen.below( u_int32_t( decisive_count ))];
+    if (blocking_count)
+        return blocking[gen.below( u_int32_t( blocking_count ))];
+    if (level != Weighted)
+        return gen.below( u_int32_t( moves.size()));
+
+    // without decisive and blocking moves all moves are weighted
+    u_int32_t r = gen.below( total );
+    size_t idx = 0;
+    while (r >= weights[idx])
+        r -= weights[idx++];
+    return idx;
+}
+
+} // namespace {
+
+size_t decisive( Rule const& rule, vector< Move > const& moves, Player player, Random& gen )
+{
+    return choose( rule, moves, player, gen, Decisive );
+}
+
+size_t anti_decisive( Rule const& rule, vector< Move > const& moves, Player player, Random& gen )
+{
+    return choose( rule, moves, player, gen, AntiDecisive );
+}
+
+size_t weighted( Rule const& rule, vector< Move > const& moves, Player player, Random& gen )
+{
+    return choose( rule, moves, player, gen, Weighted );
+}
+
+} // namespace playout {
+
 } // namespace meta_tic_tac_toe {
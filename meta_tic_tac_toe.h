@@ -1,5 +1,6 @@
 #pragma once
 #include "tic_tac_toe.h"
+#include "random.h"
 
 #include <iostream>
 
@@ -29,11 +30,31 @@ struct Rule : public GenericRule< Move >
     Player* meta_board;
     std::vector< Move > move_stack;
     std::array< bool, item_size > terminals;
-    static std::vector< Move > moves;
+    static thread_local std::vector< Move > moves;
 };
 
+// number of empty cells in inner boards which are not decided yet
+size_t empty_cells( Rule const& rule );
+
+/* true if the move, already applied to the rule, has decided its inner board
+   or sends the opponent to a decided or full board, which frees their choice */
+bool is_forcing( Rule const& rule, Move move );
+
 namespace simple_estimate {
 double eval( Rule& rule, double factor );
 } // namespace simple_estimate {
 
+/* playout policies, they return the index of the chosen move. A decisive
+   move wins the game or its inner board, an anti-decisive move takes a cell
+   the opponent would complete a line of its inner board with. */
+namespace playout {
+// a decisive move, else a random one
+size_t decisive( Rule const&, std::vector< Move > const&, Player, Random& );
+// a decisive move, else an anti-decisive one, else a random one
+size_t anti_decisive( Rule const&, std::vector< Move > const&, Player, Random& );
+/* a decisive move, else an anti-decisive one, else sampled by the open
+   lines through the cell and the own cells on them */
+size_t weighted( Rule const&, std::vector< Move > const&, Player, Random& );
+} // namespace playout {
+
 } // namespace meta_tic_tac_toe {
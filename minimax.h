@@ -1,60 +1,100 @@
 #pragma once
 
 #include "rule.h"
+#include "extension.h"
+#include "reorder.h"
+#include "arena.h"
+#include "reclaimer.h"
+#include "transposition.h"
+#include "tree_file.h"
+#include "random.h"
 
 #include <algorithm>
 #include <array>
-#include <list>
 #include <cmath>
-#include <random>
-
-#include <boost/pool/pool_alloc.hpp>
-
-template< typename MoveT >
-struct Vertex;
-
-template< typename MoveT >
-using VertexList = std::list<
-    Vertex< MoveT >,
-    boost::fast_pool_allocator< Vertex< MoveT >,
-    boost::default_user_allocator_new_delete,
-    boost::details::pool::null_mutex > >;
+#include <cstdint>
+#include <limits>
+#include <tuple>
+#include <optional>
+#include <vector>
+#include <atomic>
+#include <unordered_map>
+#include <chrono>
 
 template< typename MoveT >
 struct Vertex
 {
+    Vertex() = default;
     Vertex( MoveT const& move ) : move( move ) {}
-    Vertex( Vertex const& ) = delete;
-    Vertex& operator=( Vertex const& vertex ) = delete;
-    Vertex& operator=( Vertex&& vertex )
+
+    // result of the last search, zero if not searched yet
+    double value() const
     {
-        move = vertex.move;
-        value = vertex.value;
-        is_terminal = vertex.is_terminal;
+        if (lower == upper)
+            return lower;
+        else if (upper == player1_won)
+            return lower == player2_won ? 0.0 : lower;
+        else
+            return upper;
+    }
 
-        // no copies or assignments by moving
-        VertexList< MoveT > temp_list( std::move( vertex.children ));
-        assert (vertex.children.empty()); // vertex has no more children now
-        swap( children, temp_list );
+    bool is_exact() const
+    {
+        return lower == upper;
+    }
 
-        return *this;
-    };
+    // soft-fail result of a search with window (alpha, beta)
+    void set_value( double value, double alpha, double beta )
+    {
+        lower = value <= alpha ? player2_won : value;
+        upper = value >= beta ? player1_won : value;
+    }
 
-    double value = 0.0;
-    VertexList< MoveT > children;
-    MoveT move;
+    // bounds of the true value, quantized to single precision
+    float lower = player2_won;
+    float upper = player1_won;
+    // index of the first child in the arena
+    u_int32_t children = Arena< Vertex >::none;
+    u_int8_t child_count = 0;
+    MoveT move = MoveT();
+    // plies searched below the vertex
+    u_int8_t depth = 0;
     bool is_terminal = false;
 };
 
+static_assert (sizeof( Vertex< u_int8_t > ) == 16);
+
+template< typename MoveT >
+using VertexArena = Arena< Vertex< MoveT > >;
+
+template< typename MoveT >
+using VertexRange = Children< Vertex< MoveT > const >;
+
 template< typename MoveT >
 struct Minimax;
 
 enum RecState { Continue, SoftStop, HardStop };
 
+// order of the moves of a new vertex, the search sorts its children by value
+enum MoveOrdering { ShuffleOrdering, ScoreOrdering, HistoryOrdering };
+
 template< typename MoveT >
 struct Recursion
 {
     virtual RecState operator()( Minimax< MoveT > const& ) = 0;
+    // called before the first pass of a search
+    virtual void start( Minimax< MoveT > const& ) {}
+    // plies to search below the current vertex in this pass, bounds of a
+    // vertex searched at least that deep are reused
+    virtual size_t remaining_depth( Minimax< MoveT > const& ) const 
+    { 
+        return std::numeric_limits< size_t >::max(); 
+    }
+    // true if the tree may grow by bytes outside of an expansion, e.g. by a table entry
+    virtual bool allows( Minimax< MoveT > const&, size_t /*bytes*/ ) const
+    {
+        return true;
+    }
     virtual ~Recursion() {}
 };
 
@@ -74,35 +114,69 @@ struct Minimax
     Recursion< MoveT >& recursion;
 
     Vertex< MoveT > root = MoveT();
+    // all vertices except the root, a new generation is started on each move
+    VertexArena< MoveT > arena;
+    // release discarded generations on the background reclaimer
+    bool background_reclamation = true;
     size_t rec_count = 0;
-    size_t vertex_count = 0;
+    // a helper thread counts its vertices in the main search
+    std::atomic< size_t > vertex_count = 0;
+    Minimax* main_search = nullptr;
+    // searches decided by the bounds of a previous pass
+    size_t reused = 0;
     size_t depth = 0;
-    std::random_device rd;
-    std::mt19937 g { rd() };
+    ForcingExtensions< MoveT > forcing;
+    typedef std::unordered_map< std::uint64_t, Vertex< MoveT > > Table;
+    // positions reached by different move orders share one vertex, the tree becomes a dag
+    bool transpositions = false;
+    PositionKey< MoveT > position;
+    // shared vertex by position key
+    Table table;
+    // new vertices of a position already searched on another line
+    size_t merged = 0;
+    // heap bytes of the tree, a helper thread counts its bytes in the main search
+    std::atomic< size_t > memory = 0;
+    // heap bytes of released generations until the reclaimer frees them, shared with the helpers
+    std::shared_ptr< std::atomic< size_t > > reclaiming = std::make_shared< std::atomic< size_t > >( 0 );
+    // threads growing the tree at once, each may start a new arena block
+    size_t threads = 1;
+    // table entry with its node and bucket pointers
+    static constexpr size_t table_entry_bytes = sizeof( typename Table::value_type ) + 2 * sizeof( void* );
+    // extended plies of the current line, they do not count in depth
+    size_t extended = 0;
+    size_t extensions = 0;
+    // a good first order of new children prunes more in their first pass
+    MoveOrdering ordering = ShuffleOrdering;
+    ReorderByScore< MoveT > by_score { eval };
+    ReorderByHistory< MoveT > by_history;
+    // moves of the vertex being expanded, eval may generate moves again
+    std::vector< MoveT > ordered;
+    Random g;
     std::function< void (Minimax*) > debug;
     std::atomic< bool > stop = false;
 
-    static bool prune1( double& alpha, double& beta, double& value,
-                        Vertex< MoveT >& vertex )
+    static bool prune1( double& alpha, double& beta, double& value, double child_value )
     {
-        if (vertex.value > value)
-            value = vertex.value;
+        if (child_value > value)
+            value = child_value;
         if (value > alpha)
             alpha = value;
         // prune soft-fail
         return (value >= beta);
     }
 
+    // exact values first on ties
     static bool pred1( Vertex< MoveT > const& lhs, Vertex< MoveT > const& rhs)
     {
-        return lhs.value > rhs.value;
+        const double lhs_value = lhs.value();
+        const double rhs_value = rhs.value();
+        return lhs_value > rhs_value || (lhs_value == rhs_value && lhs.is_exact() && !rhs.is_exact());
     }
 
-    static bool prune2( double& alpha, double& beta, double& value,
-                        Vertex< MoveT >& vertex )
+    static bool prune2( double& alpha, double& beta, double& value, double child_value )
     {
-        if (vertex.value < value)
-            value = vertex.value;
+        if (child_value < value)
+            value = child_value;
         if (value < beta)
             beta = value;
         // prune soft-fail
@@ -111,11 +185,129 @@ struct Minimax
 
     static bool pred2( Vertex< MoveT > const& lhs, Vertex< MoveT > const& rhs)
     {
-        return lhs.value < rhs.value;
+        const double lhs_value = lhs.value();
+        const double rhs_value = rhs.value();
+        return lhs_value < rhs_value || (lhs_value == rhs_value && lhs.is_exact() && !rhs.is_exact());
+    }
+
+    typedef bool (*Prune)( double&, double&, double&, double );
+    typedef bool (*Pred)( Vertex< MoveT > const&, Vertex< MoveT > const& );
+
+    // pruning, child order and the worst value for player
+    static std::tuple< Prune, Pred, double > strategy( Player player )
+    {
+        if (player == player1)
+            return { &Minimax< MoveT >::prune1, &Minimax< MoveT >::pred1, player2_won };
+        else
+            return { &Minimax< MoveT >::prune2, &Minimax< MoveT >::pred2, player1_won };
+    }
+
+    // stable insertion sort in place, the order changes little between passes
+    static void sort( Children< Vertex< MoveT > > range, Pred pred )
+    {
+        for (auto itr = range.begin() + 1; itr < range.end(); ++itr)
+        {
+            const Vertex< MoveT > child = *itr;
+            auto pos = itr;
+            for (; pos != range.begin() && pred( child, *(pos - 1)); --pos)
+                *pos = *(pos - 1);
+            *pos = child;
+        }
+    }
+
+    // vertices added in this search by all threads
+    size_t vertices() const
+    {
+        return main_search ? main_search->vertices() : vertex_count.load();
+    }
+
+    // heap bytes of the tree of all threads
+    size_t allocated_bytes() const
+    {
+        return main_search ? main_search->allocated_bytes() : memory.load() + reclaiming->load();
+    }
+
+    size_t growing_threads() const
+    {
+        return main_search ? main_search->threads : threads;
+    }
+
+    void add_vertices( size_t count )
+    {
+        (main_search ? main_search->vertex_count : vertex_count) += count;
+    }
+
+    void add_bytes( size_t bytes )
+    {
+        (main_search ? main_search->memory : memory) += bytes;
+    }
+
+    // count the bytes of a new tree
+    void count_bytes()
+    {
+        memory = arena.bytes() + table.size() * table_entry_bytes;
+    }
+
+    // the bounds of a deep enough previous search decide the result
+    bool is_decided( Vertex< MoveT > const& vertex, double alpha, double beta ) const
+    {
+        return    vertex.depth >= recursion.remaining_depth( *this )
+               && (vertex.is_exact() || vertex.lower >= beta || vertex.upper <= alpha);
+    }
+
+    Children< Vertex< MoveT > > children( Vertex< MoveT > const& vertex )
+    {
+        if (!vertex.child_count)
+            return {};
+        Vertex< MoveT >* first = &arena[vertex.children];
+        return { first, first + vertex.child_count };
+    }
+
+    VertexRange< MoveT > children( Vertex< MoveT > const& vertex ) const
+    {
+        if (!vertex.child_count)
+            return {};
+        Vertex< MoveT > const* first = &arena[vertex.children];
+        return { first, first + vertex.child_count };
     }
 
     // return true if hard stop
     bool rec( double alpha, double beta, Player player, Vertex< MoveT >& vertex )
+    {
+        if (!transpositions)
+            return rec_vertex( alpha, beta, player, vertex );
+
+        // search the shared vertex of the position and refresh the copy of the parent
+        auto itr = table.find( position.key );
+        const bool inserted = itr == table.end();
+        if (inserted)
+        {
+            // without room for a table entry the vertex is not shared
+            if (!recursion.allows( *this, table_entry_bytes ))
+                return rec_vertex( alpha, beta, player, vertex );
+            itr = table.emplace( position.key, vertex ).first;
+            add_bytes( table_entry_bytes );
+            // a new position, the vertices of a dag count once
+            add_vertices( 1 );
+        }
+        Vertex< MoveT >& shared = itr->second;
+        if (!inserted && vertex.lower == player2_won && vertex.upper == player1_won
+            && (shared.depth || shared.is_exact()))
+            ++merged;
+        const bool hard_stop = rec_vertex( alpha, beta, player, shared );
+        refresh( vertex, shared );
+        return hard_stop;
+    }
+
+    // copy the search result of the shared vertex of a position
+    static void refresh( Vertex< MoveT >& vertex, Vertex< MoveT > const& shared )
+    {
+        const MoveT move = vertex.move;
+        vertex = shared;
+        vertex.move = move;
+    }
+
+    bool rec_vertex( double alpha, double beta, Player player, Vertex< MoveT >& vertex )
     {
         ++rec_count;
 
@@ -126,13 +318,20 @@ struct Minimax
         if (vertex.is_terminal)
             return false;
 
+        if (is_decided( vertex, alpha, beta ))
+        {
+            ++reused;
+            return false;
+        }
+
         // if no children generated yet (or no available)
-        if (vertex.children.empty())
+        if (!vertex.child_count)
         {
             const Player winner = rule->get_winner();
             if (winner != not_set)
             {
-                vertex.value = winner * player1_won;
+                vertex.lower = vertex.upper = winner * player1_won;
+                vertex.depth = max_vertex_depth;
                 vertex.is_terminal = true; // if winner, it's terminal
                 return false;
             }
@@ -142,7 +341,8 @@ struct Minimax
             if (moves.empty())
             {
                 // no winner, no moves: it's a draw and terminal
-                vertex.value = 0.0;
+                vertex.lower = vertex.upper = 0.0;
+                vertex.depth = max_vertex_depth;
                 vertex.is_terminal = true;
                 return false;
             }
@@ -151,89 +351,275 @@ struct Minimax
             const RecState rec_state = recursion(*this);
             if (rec_state == SoftStop)
             {
-                vertex.value = eval( *rule, player );
+                vertex.lower = vertex.upper = eval( *rule, player );
+                vertex.depth = 0;
                 return false;
             }
             else if (rec_state == HardStop)
                 return true;
 
-            // mix in some randomness
-            std::shuffle( moves.begin(), moves.end(), g );
-
-            for (MoveT const& move : moves)
-                vertex.children.emplace_back( move );
-            vertex_count += moves.size();
+            // mix in some randomness, an ordering keeps it among equal moves
+            ordered.assign( moves.begin(), moves.end());
+            g.shuffle( ordered.begin(), ordered.end());
+            order( player, vertex );
+
+            assert (ordered.size() <= 255);
+            const size_t bytes = arena.bytes();
+            vertex.children = arena.allocate( ordered.size());
+            add_bytes( arena.bytes() - bytes );
+            vertex.child_count = u_int8_t( ordered.size());
+            Vertex< MoveT >* child = &arena[vertex.children];
+            for (MoveT const& move : ordered)
+                *child++ = Vertex< MoveT >( move );
+            // with transpositions the children count when their position is new
+            if (!transpositions)
+                add_vertices( ordered.size());
         }
 
-        double value;
-        bool (*prune)( double&, double&, double&, Vertex< MoveT >& );
-        bool (*pred)(Vertex< MoveT > const&, Vertex< MoveT > const& );
-
-        if (player == player1)
-        {
-            prune = &Minimax< MoveT >::prune1;
-            pred = &Minimax< MoveT >::pred1;
-            value = player2_won;
-        }
-        else
-        {
-            prune = &Minimax< MoveT >::prune2;
-            pred = &Minimax< MoveT >::pred2;
-            value = player1_won;
-        }
+        const double alpha_orig = alpha;
+        const double beta_orig = beta;
+        auto [prune, pred, value] = strategy( player );
 
         bool is_terminal = true;
+        size_t min_depth = max_vertex_depth;
 
-        for (auto itr = vertex.children.begin();
-             itr != vertex.children.end(); ++itr)
+        // the arena never moves vertices, the children stay in place while it grows
+        auto range = children( vertex );
+        auto itr = range.begin();
+        for (; itr != range.end(); ++itr)
         {
-            ++depth;
-            rule->apply_move( itr->move, player );
-            const bool hard_stop = rec( alpha, beta, Player( -player ), *itr);
-            rule->undo_move( itr->move, player1 );
-            --depth;
-
-            if (hard_stop)
+            if (rec_child( alpha, beta, player, *itr ))
                 return true;
 
             is_terminal &= itr->is_terminal;
+            min_depth = std::min< size_t >( min_depth, itr->depth );
 
-            if (prune( alpha, beta, value, *itr ))
+            if (prune( alpha, beta, value, itr->value()))
+            {
+                if (ordering == HistoryOrdering)
+                    by_history.cutoff( itr->move, player,
+                        std::min( recursion.remaining_depth( *this ), size_t( itr->depth ) + 1 ),
+                        ply(), previous_move( vertex ));
                 break;
+            }
         }
 
-        vertex.value = value;
-        vertex.is_terminal = is_terminal;
-        vertex.children.sort( pred );
+        vertex.set_value( value, alpha_orig, beta_orig );
+        vertex.depth = u_int8_t( std::min( min_depth + 1, max_vertex_depth ));
+        // a cutoff before the last child decides only a won or lost position
+        vertex.is_terminal = is_terminal && (itr == range.end() || vertex.is_exact());
+
+        sort( range, pred );
 
         return false;
     }
 
+    // plies from the root of the current vertex
+    size_t ply() const
+    {
+        return depth + extended - 1;
+    }
+
+    // move leading to the current vertex, none at the root
+    std::optional< MoveT > previous_move( Vertex< MoveT > const& vertex ) const
+    {
+        if (!ply())
+            return std::nullopt;
+        return vertex.move;
+    }
+
+    // order the moves of the new current vertex with player to move
+    void order( Player player, Vertex< MoveT > const& vertex )
+    {
+        if (ordering == ScoreOrdering)
+            by_score( *rule, player, ordered.begin(), ordered.end());
+        else if (ordering == HistoryOrdering)
+        {
+            by_history.set_node( ply(), previous_move( vertex ));
+            by_history( *rule, player, ordered.begin(), ordered.end());
+        }
+    }
+
+    // search the child of a vertex with player to move, return true if hard stop
+    bool rec_child( double alpha, double beta, Player player, Vertex< MoveT >& child )
+    {
+        rule->apply_move( child.move, player );
+        position.apply_move( child.move, player );
+        const bool extend = forcing.extends( *rule, child.move, extended );
+        if (extend)
+        {
+            ++extended;
+            ++extensions;
+        }
+        else
+            ++depth;
+        const bool hard_stop = rec( alpha, beta, Player( -player ), child );
+        if (extend)
+            --extended;
+        else
+            --depth;
+        position.undo_move( child.move, player );
+        rule->undo_move( child.move, player1 );
+        return hard_stop;
+    }
+
     void apply_move( MoveT const& move, Player player )
     {
         rule->apply_move( move, player );
-        auto itr = find_if( root.children.begin(), root.children.end(),
+        position.apply_move( move, player );
+        auto range = children( root );
+        auto itr = std::find_if( range.begin(), range.end(),
             [&move]( Vertex< MoveT > const& vertex) { return vertex.move == move; });
-        if (itr != root.children.end())
-            root = std::move( *itr );
+        const Vertex< MoveT > new_root = itr != range.end() ? *itr : Vertex< MoveT >( move );
+
+        // copy the subtree of the new root to the next generation and release the rest at once
+        VertexArena< MoveT > next;
+        root = new_root;
+        if (transpositions)
+        {
+            Table next_table;
+            std::unordered_map< u_int32_t, u_int32_t > copied;
+            copy_shared( root, Player( -player ), next, next_table, copied );
+            table.swap( next_table );
+            release( std::move( next_table ));
+        }
         else
-            root = Vertex< MoveT >( move );
+            copy_children( root, next );
+        arena.swap( next );
+        release( std::move( next ));
+        count_bytes();
+    }
+
+    void reset()
+    {
+        root = Vertex< MoveT >( MoveT());
+        position.reset();
+        release( std::move( arena ));
+        arena.clear();
+        release( std::move( table ));
+        table.clear();
+        count_bytes();
+    }
+
+    // save the tree of the current position
+    bool save( std::string const& path ) const
+    {
+        return save_tree( path, position.key, root, arena );
+    }
+
+    // continue with a tree saved for the current position, the file is mapped
+    bool load( std::string const& path )
+    {
+        Vertex< MoveT > loaded;
+        VertexArena< MoveT > mapped;
+        if (!load_tree( path, position.key, loaded, mapped ))
+            return false;
+        root = loaded;
+        arena.swap( mapped );
+        release( std::move( mapped ));
+        // the shared vertices are found again while searching
+        release( std::move( table ));
+        table.clear();
+        count_bytes();
+        return true;
+    }
+
+    void release( VertexArena< MoveT >&& generation )
+    {
+        if (background_reclamation)
+        {
+            const size_t bytes = generation.bytes();
+            Reclaimer::instance().reclaim( 
+                std::make_shared< VertexArena< MoveT > >( std::move( generation )), bytes, reclaiming );
+        }
+        else
+            generation.clear();
+    }
+
+    void release( Table&& generation )
+    {
+        if (background_reclamation)
+        {
+            const size_t bytes = generation.size() * table_entry_bytes;
+            Reclaimer::instance().reclaim( std::make_shared< Table >( std::move( generation )), bytes, reclaiming );
+        }
+        else
+            generation.clear();
+    }
+
+    // copy the descendants of the already copied vertex to the arena to
+    void copy_children( Vertex< MoveT >& vertex, VertexArena< MoveT >& to ) const
+    {
+        if (!vertex.child_count)
+            return;
+        const u_int32_t first = to.allocate( vertex.child_count );
+        for (size_t idx = 0; idx != vertex.child_count; ++idx)
+        {
+            Vertex< MoveT >& child = to[first + idx];
+            child = arena[vertex.children + idx];
+            copy_children( child, to );
+        }
+        vertex.children = first;
+    }
+
+    /* copy the descendants of the already copied vertex of the current position
+       with player to move, shared children are copied once. The shared vertices
+       of the copied positions are kept in the table to. */
+    void copy_shared( Vertex< MoveT >& vertex, Player player, VertexArena< MoveT >& to, Table& to_table,
+                      std::unordered_map< u_int32_t, u_int32_t >& copied )
+    {
+        auto shared = table.find( position.key );
+        if (shared != table.end())
+            refresh( vertex, shared->second );
+
+        if (vertex.child_count)
+        {
+            // the recursion inserts into copied, keep no iterator into it
+            auto itr = copied.find( vertex.children );
+            if (itr != copied.end())
+                vertex.children = itr->second;
+            else
+            {
+                const u_int32_t first = to.allocate( vertex.child_count );
+                copied.emplace( vertex.children, first );
+                for (size_t idx = 0; idx != vertex.child_count; ++idx)
+                {
+                    Vertex< MoveT >& child = to[first + idx];
+                    child = arena[vertex.children + idx];
+                    position.apply_move( child.move, player );
+                    copy_shared( child, Player( -player ), to, to_table, copied );
+                    position.undo_move( child.move, player );
+                }
+                vertex.children = first;
+            }
+        }
+
+        if (shared != table.end())
+            to_table.try_emplace( position.key, vertex );
     }
 
     double operator()( Player player )
     {
         rec_count = 0;
         vertex_count = 0;
+        merged = 0;
+        if (ordering == HistoryOrdering)
+            by_history.age();
+        recursion.start( *this );
 
         do
         {
             depth = 1;
+            extended = 0;
             rec( player2_won, player1_won, player, root );
             depth = 0;
         } while (recursion( *this ) == Continue);
 
-        return root.value;
+        return root.value();
     }
+
+    // depth of terminal vertices
+    static constexpr size_t max_vertex_depth = 255;
 };
 
 template< typename MoveT >
@@ -261,6 +647,11 @@ struct MaxDepth : public Recursion< MoveT >
         return minimax.depth < depth ? Continue : SoftStop;
     }
 
+    size_t remaining_depth( Minimax< MoveT > const& minimax ) const
+    {
+        return depth > minimax.depth ? depth - minimax.depth : 0;
+    }
+
     const size_t max_depth;
     size_t depth = 1;
 };
@@ -272,11 +663,14 @@ struct MaxVertices : public Recursion< MoveT >
 
     RecState operator()( Minimax< MoveT > const& minimax )
     {
-        const bool allowed = minimax.vertex_count < max_vertices;
+        const bool allowed = minimax.vertices() < max_vertices;
 
         if (minimax.depth == 0)
         {
-            if (!allowed || minimax.root.is_terminal)
+            // a pass without leaves leaves nothing to deepen
+            const bool complete = !leaves;
+            leaves = 0;
+            if (!allowed || minimax.root.is_terminal || complete)
             {
                 if (depth > 2)
                     depth -= 2;
@@ -290,6 +684,7 @@ struct MaxVertices : public Recursion< MoveT >
             return Continue;
         }
 
+        ++leaves;
         if (!allowed)
             return HardStop;
         else if (minimax.depth > depth)
@@ -298,14 +693,167 @@ struct MaxVertices : public Recursion< MoveT >
             return Continue;
     }
 
+    size_t remaining_depth( Minimax< MoveT > const& minimax ) const
+    {
+        return depth + 1 > minimax.depth ? depth + 1 - minimax.depth : 0;
+    }
+
     const size_t max_vertices;
     size_t depth = 1;
+    // leaves reached in the current pass
+    std::atomic< size_t > leaves = 0;
+};
+
+/* limits the heap bytes of the tree, including the transposition table.
+   Vertices are added as long as an expansion cannot exceed the budget, a
+   new arena block may be needed for it by each thread. Beyond that the
+   search degrades to evaluating the leaves, so the last pass completes, a
+   table entry is only added while it fits. A tree kept from the previous
+   move and generations not yet freed by the reclaimer count against the
+   budget. */
+template< typename MoveT >
+struct MaxMemory : public Recursion< MoveT >
+{
+    MaxMemory( size_t max_bytes ) : max_bytes( max_bytes ) {}
+
+    RecState operator()( Minimax< MoveT > const& minimax )
+    {
+        // the root is expanded before the helper threads start
+        const size_t threads = minimax.depth == 1 ? 1 : minimax.growing_threads();
+        const bool allowed = minimax.allocated_bytes() + reserve * threads < max_bytes;
+
+        if (minimax.depth == 0)
+        {
+            const bool complete = !leaves;
+            leaves = 0;
+            if (!allowed || minimax.root.is_terminal || complete)
+            {
+                if (depth > 2)
+                    depth -= 2;
+                else
+                    depth = 1;
+                return SoftStop;
+            }
+
+            ++depth;
+
+            return Continue;
+        }
+
+        ++leaves;
+        return allowed && minimax.depth <= depth ? Continue : SoftStop;
+    }
+
+    size_t remaining_depth( Minimax< MoveT > const& minimax ) const
+    {
+        return depth + 1 > minimax.depth ? depth + 1 - minimax.depth : 0;
+    }
+
+    bool allows( Minimax< MoveT > const& minimax, size_t bytes ) const
+    {
+        return minimax.allocated_bytes() + bytes <= max_bytes;
+    }
+
+    // growth of one expansion
+    static constexpr size_t reserve = 
+        VertexArena< MoveT >::block_size * sizeof( Vertex< MoveT > ) + Minimax< MoveT >::table_entry_bytes;
+
+    const size_t max_bytes;
+    size_t depth = 1;
+    std::atomic< size_t > leaves = 0;
+};
+
+/* limits the time of a search. The passes of the iterative deepening are
+   timed, the next pass is predicted from the node rate and the growth of
+   the node count of the last pass, it is only started if it is expected to
+   finish before the deadline. A pass running into the deadline anyway is
+   abandoned with a hard stop. */
+template< typename MoveT >
+struct MaxTime : public Recursion< MoveT >
+{
+    typedef std::chrono::steady_clock Clock;
+
+    MaxTime( std::chrono::milliseconds budget, double max_growth = 8.0 ) 
+    : budget( budget ), max_growth( max_growth ) {}
+
+    void start( Minimax< MoveT > const& minimax )
+    {
+        pass_start = Clock::now();
+        deadline = pass_start + budget;
+        pass_recs = minimax.rec_count;
+        last_pass_recs = 0;
+        passes = 0;
+    }
+
+    RecState operator()( Minimax< MoveT > const& minimax )
+    {
+        const Clock::time_point now = Clock::now();
+
+        if (minimax.depth == 0)
+        {
+            // nodes and time of the pass just finished
+            const size_t recs = minimax.rec_count - pass_recs;
+            const double seconds = std::chrono::duration< double >( now - pass_start ).count();
+            // passes decided by the tree of a previous search are cheap, bound the growth
+            const double growth = last_pass_recs 
+                ? std::clamp( double( recs ) / double( last_pass_recs ), 1.0, max_growth ) : 1.0;
+            if (seconds > 0.0 && recs)
+                rate = double( recs ) / seconds;
+            predicted = std::chrono::duration_cast< Clock::duration >( 
+                std::chrono::duration< double >( rate > 0.0 ? double( recs ) * growth / rate : 0.0 ));
+            last_pass_recs = recs;
+            pass_recs = minimax.rec_count;
+            pass_start = now;
+            ++passes;
+            const bool complete = !leaves;
+            leaves = 0;
+
+            if (   minimax.root.is_terminal || complete || now + predicted >= deadline
+                || depth >= Minimax< MoveT >::max_vertex_depth)
+            {
+                if (depth > 2)
+                    depth -= 2;
+                else
+                    depth = 1;
+                return SoftStop;
+            }
+
+            ++depth;
+
+            return Continue;
+        }
+
+        ++leaves;
+        if (now >= deadline)
+            return HardStop;
+        return minimax.depth < depth ? Continue : SoftStop;
+    }
+
+    size_t remaining_depth( Minimax< MoveT > const& minimax ) const
+    {
+        return depth > minimax.depth ? depth - minimax.depth : 0;
+    }
+
+    const Clock::duration budget;
+    // bound of the node count growth from pass to pass
+    const double max_growth;
+    Clock::time_point deadline;
+    Clock::time_point pass_start;
+    size_t pass_recs = 0;
+    size_t last_pass_recs = 0;
+    // nodes per second of the last timed pass
+    double rate = 0.0;
+    // predicted duration of the next pass
+    Clock::duration predicted = Clock::duration::zero();
+    size_t passes = 0;
+    size_t depth = 1;
+    std::atomic< size_t > leaves = 0;
 };
 
 template< typename MoveT >
 struct ChooseFirst
 {
-    MoveT const& operator()(VertexList< MoveT > const& children)
+    MoveT const& operator()(VertexRange< MoveT > const& children)
     {
         return children.front().move;
     }
@@ -316,20 +864,21 @@ struct ChooseMove
 {
     ChooseMove( double epsilon ) : epsilon( epsilon ) {}
 
-    MoveT const& operator()(VertexList< MoveT > const& children)
+    MoveT const& operator()(VertexRange< MoveT > const& children)
     {
-        const double v = children.front().value;
+        const double v = children.front().value();
         moves.clear();
-        for (auto itr = children.begin(); itr != children.end()
-             && (std::isnan( itr->value - v)
-                 || std::abs( itr->value - v ) <= epsilon); ++itr)
-            moves.push_back( itr->move );
-        auto dist = std::uniform_int_distribution< int >( 0, moves.size() - 1);
-        return moves[dist( g )];
+        moves.push_back( children.front().move );
+        // the value of a cut off child is only a bound
+        for (auto itr = children.begin() + 1; itr != children.end()
+             && (std::isnan( itr->value() - v)
+                 || std::abs( itr->value() - v ) <= epsilon); ++itr)
+            if (itr->is_exact())
+                moves.push_back( itr->move );
+        return moves[g.below( u_int32_t( moves.size()))];
     }
 
     const double epsilon;
     std::vector< MoveT > moves;
-    std::random_device rd;
-    std::mt19937 g { rd() };
+    Random g;
 };
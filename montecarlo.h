@@ -2,74 +2,134 @@
 
 #include "rule.h"
 
-#include <boost/pool/pool_alloc.hpp>
+#include "arena.h"
+#include "reclaimer.h"
+#include "transposition.h"
+#include "tree_file.h"
+#include "random.h"
 
-#include <list>
 #include <memory>
-#include <optional>
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <atomic>
+#include <functional>
+#include <utility>
 
 namespace montecarlo {
 
+/* chooses the next move of a playout, returns its index in the moves.
+   The moves are the moves of the rule, the player is to move. */
 template< typename MoveT >
-struct Node;
+using PlayoutPolicy = std::function< size_t (
+    GenericRule< MoveT > const&, std::vector< MoveT > const&, Player, Random& ) >;
 
-template< typename MoveT >
-using NodeList = std::list<
-    Node< MoveT >,
-    boost::fast_pool_allocator< Node< MoveT >,
-    boost::default_user_allocator_new_delete,
-    boost::details::pool::null_mutex > >;
+// expansion of a node in the tree-parallel search
+enum Expansion : u_int8_t { Unclaimed, Expanding, Expanded };
 
+/* compact node, four nodes share a cache line, so selection streams
+   through the contiguous children. The wins are counted in fixed point
+   half points, so the statistics are integers. */
 template< typename MoveT >
 struct Node
 {
+    Node() = default;
     Node( MoveT const& move ) : move( move ) {}
-    Node( Node const& ) = delete;
-    /*Node( Node const& node ) : move( node.move ), numerator( node.numerator ),
-        denominator( node.denominator ), is_terminal( node.is_terminal ), children( node.children )
-    {}*/
-
-    Node& operator=( Node const& ) = delete;
-    Node& operator=( Node&& node )
-    {
-        move = node.move;
-        numerator = node.numerator;
-        denominator = node.denominator;
-        is_terminal = node.is_terminal;
-
-        // no copies or assignments by moving
-        NodeList< MoveT > temp_list( std::move( node.children ));
-        assert (node.children.empty());
-        swap( children, temp_list );
-
-        return *this;
-    };
-
-    MoveT move;
-    double numerator = 0.0;
-    size_t denominator = 0;
-    std::optional< Player > is_terminal;
-    NodeList< MoveT > children;
+
+    bool is_terminal() const
+    {
+        return terminal != no_result;
+    }
+
+    // result of a terminal or proven node, not_set for a draw
+    Player winner() const
+    {
+        return winner( terminal );
+    }
+
+    void set_terminal( Player winner )
+    {
+        terminal = result( winner );
+    }
+
+    static u_int8_t result( Player winner )
+    {
+        return u_int8_t( winner + 2 );
+    }
+
+    static Player winner( u_int8_t result )
+    {
+        return Player( int( result ) - 2 );
+    }
+
+    // won simulations of the player to move, a draw counts half
+    double wins() const
+    {
+        return 0.5 * half_points;
+    }
+
+    static constexpr u_int8_t no_result = 0;
+
+    MoveT move = MoveT();
+    u_int8_t child_count = 0;
+    // result of the game or proven by the children
+    u_int8_t terminal = no_result;
+    // children and result are published by the tree-parallel search
+    u_int8_t expansion = Unclaimed;
+    // index of the first child in the arena
+    u_int32_t children = Arena< Node >::none;
+    u_int32_t denominator = 0;
+    // a win counts two, a draw one
+    u_int32_t half_points = 0;
 };
 
+static_assert (sizeof( Node< u_int8_t > ) == 16);
+
+template< typename MoveT >
+using NodeArena = Arena< Node< MoveT > >;
+
+template< typename MoveT >
+using NodeRange = Children< Node< MoveT > const >;
+
 template< typename MoveT >
 struct MCTS
 {
     MCTS( GenericRule< MoveT > const& initial_rule, double exploration )
-    : rule( initial_rule.clone()), playout_rule( initial_rule.clone()), exploration( exploration ), gen( rd())
+    : rule( initial_rule.clone()), playout_rule( initial_rule.clone()), exploration( exploration )
     {}
 
+    Children< Node< MoveT > > children( Node< MoveT > const& node )
+    {
+        if (!node.child_count)
+            return {};
+        Node< MoveT >* first = &arena[node.children];
+        return { first, first + node.child_count };
+    }
+
+    NodeRange< MoveT > children( Node< MoveT > const& node ) const
+    {
+        if (!node.child_count)
+            return {};
+        Node< MoveT > const* first = &arena[node.children];
+        return { first, first + node.child_count };
+    }
+
     Node< MoveT >& select( Node< MoveT >& node )
     {
-        assert (!node.children.empty());
+        assert (node.child_count);
 
         values.clear();
-        for (Node< MoveT >& child : node.children)
-            values.push_back( { cbt( child, node, exploration ), &child });
+        for (Node< MoveT >& child : children( node ))
+            // a won child proves the node, so only draws are left of the decided ones
+            if (!child.is_terminal() || child.winner() == not_set)
+                values.push_back( { cbt( child, node, exploration ), &child });
+
+        // all children lost, the back propagation proves the node
+        if (values.empty())
+            return children( node ).front();
 
         // mix in some randomness
-        std::shuffle( values.begin(), values.end(), gen );
+        gen.shuffle( values.begin(), values.end());
 
         auto itr = max_element( values.begin(), values.end(),
             [](auto& lhs, auto& rhs) { return lhs.first < rhs.first; });
@@ -79,10 +139,46 @@ struct MCTS
     static double cbt(
         Node< MoveT > const& child, Node< MoveT > const& node, double exploration )
     {
-        return !child.denominator
+        return cbt( child.wins(), child.denominator, node.denominator, exploration );
+    }
+
+    /* a parent without visits yet counts one, in the tree-parallel search a
+       child may carry virtual loss before its parent is backed up, the log
+       of zero made its value nan */
+    static double cbt( double wins, size_t denominator, size_t parent_denominator, double exploration )
+    {
+        return !denominator
             ? INFINITY
-            : 1 - child.numerator / child.denominator
-                + exploration * sqrt( log( node.denominator ) / child.denominator);
+            : 1 - wins / denominator
+                + exploration * sqrt( log( std::max< size_t >( parent_denominator, 1 )) / denominator);
+    }
+
+    /* mcts-solver, the result of a node with player to move proven by its
+       children: won if a child is won, else open if a child is open, else
+       drawn if a child is drawn, else lost. The results are read relaxed
+       atomic, the tree-parallel search proves nodes concurrently. */
+    static u_int8_t proven( NodeRange< MoveT > const& children, Player player )
+    {
+        const u_int8_t won = Node< MoveT >::result( player );
+        const u_int8_t drawn = Node< MoveT >::result( not_set );
+        u_int8_t result = Node< MoveT >::result( Player( -player ));
+        for (Node< MoveT > const& child : children)
+        {
+            const u_int8_t child_result = __atomic_load_n( &child.terminal, __ATOMIC_RELAXED );
+            if (child_result == won)
+                return won;
+            else if (child_result == Node< MoveT >::no_result)
+                result = Node< MoveT >::no_result;
+            else if (child_result == drawn && result != Node< MoveT >::no_result)
+                result = drawn;
+        }
+        return result;
+    }
+
+    // back up the result of a decided child
+    void prove( Node< MoveT >& node, Player player ) const
+    {
+        node.terminal = proven( children( node ), player );
     }
 
     Player playout( std::vector< MoveT >& moves, Player player)
@@ -94,9 +190,10 @@ struct MCTS
         Player winner;
         while (true)
         {
-            // apply new random move
-            auto idx = std::uniform_int_distribution<std::mt19937::result_type>(
-                0, moves.size() - 1)( rd );
+            // apply new move of the policy, uniformly random without one
+            const size_t idx = playout_policy 
+                ? playout_policy( *playout_rule, moves, player, gen )
+                : gen.below( u_int32_t( moves.size()));
             playout_rule->apply_move( moves[idx], player );
             winner = playout_rule->get_winner();
 
@@ -114,27 +211,35 @@ struct MCTS
         return winner;
     }
 
+    // create the children of a leaf
+    void expand( Node< MoveT >& node, std::vector< MoveT > const& moves )
+    {
+        assert (moves.size() <= 255);
+        node.children = arena.allocate( moves.size());
+        node.child_count = u_int8_t( moves.size());
+        Node< MoveT >* child = &arena[node.children];
+        for (MoveT const& move : moves)
+            *child++ = Node< MoveT >( move );
+    }
+
     Player simulate( Node< MoveT >& node, Player player )
     {
         Player winner;
-        if (node.is_terminal)
-            winner = *node.is_terminal;
-        else if (node.children.empty())
+        if (node.is_terminal())
+            winner = node.winner();
+        else if (!node.child_count)
         {
             winner = rule->get_winner();
             if (winner != not_set) // winner?
-                node.is_terminal = winner;
+                node.set_terminal( winner );
             else 
             {
                 auto& moves = rule->generate_moves();
                 if (moves.empty()) // draw?
-                    node.is_terminal = not_set;
+                    node.set_terminal( not_set );
                 else
                 {
-                    // expansion
-                    for (MoveT const& move : moves)
-                        node.children.emplace_back( move );
-            
+                    expand( node, moves );
                     winner = playout( moves, player );
                 }
             }
@@ -145,22 +250,24 @@ struct MCTS
             rule->apply_move( child.move, player );
             winner = simulate( child, Player( -player ));
             rule->undo_move( child.move, player );
+            if (child.is_terminal())
+                prove( node, player );
         }
 
         // back propagation
         ++node.denominator;
 
         if (winner == player)
-            node.numerator += 1.0;
+            node.half_points += 2;
         else if (winner == not_set)
-            node.numerator += 0.5;
+            node.half_points += 1;
 
         return winner;
     }
 
     void operator()( size_t simulations, Player player )
     {
-        for(; simulations && !root.is_terminal; --simulations)
+        for(; simulations && !root.is_terminal(); --simulations)
         {
             if (stop)
                 return;
@@ -171,27 +278,84 @@ struct MCTS
     void apply_move( MoveT const& move, Player player )
     {
         rule->apply_move( move, player );
-        auto itr = find_if( root.children.begin(), root.children.end(),
+        position.apply_move( move, player );
+        auto range = children( root );
+        auto itr = std::find_if( range.begin(), range.end(),
             [&move]( Node< MoveT > const& node) { return node.move == move; });
-        if (itr != root.children.end())
-            root = std::move( *itr );
-        else
-            root = move;
+        const Node< MoveT > new_root = itr != range.end() ? *itr : Node< MoveT >( move );
+
+        // copy the subtree of the new root to the next generation and release the rest at once
+        NodeArena< MoveT > next;
+        root = new_root;
+        copy_children( root, next );
+        arena.swap( next );
+        release( std::move( next ));
     }
 
     void init(GenericRule< MoveT > const& r)
     {
         rule->copy_from( r );
-        root = Node< MoveT >( MoveT()); // { MoveT() }; // todo
+        position.reset();
+        root = Node< MoveT >( MoveT());
+        release( std::move( arena ));
+        arena.clear();
+    }
+
+    // copy the descendants of the already copied node to the arena to
+    void copy_children( Node< MoveT >& node, NodeArena< MoveT >& to ) const
+    {
+        if (!node.child_count)
+            return;
+        const u_int32_t first = to.allocate( node.child_count );
+        for (size_t idx = 0; idx != node.child_count; ++idx)
+        {
+            Node< MoveT >& child = to[first + idx];
+            child = arena[node.children + idx];
+            copy_children( child, to );
+        }
+        node.children = first;
+    }
+
+    // save the tree of the current position
+    bool save( std::string const& path ) const
+    {
+        return save_tree( path, position.key, root, arena );
+    }
+
+    // continue with a tree saved for the current position, the file is mapped
+    bool load( std::string const& path )
+    {
+        Node< MoveT > loaded;
+        NodeArena< MoveT > mapped;
+        if (!load_tree( path, position.key, loaded, mapped ))
+            return false;
+        root = loaded;
+        arena.swap( mapped );
+        release( std::move( mapped ));
+        return true;
+    }
+
+    void release( NodeArena< MoveT >&& generation )
+    {
+        if (background_reclamation)
+            Reclaimer::instance().reclaim( std::make_shared< NodeArena< MoveT > >( std::move( generation )));
+        else
+            generation.clear();
     }
 
     std::unique_ptr< GenericRule< MoveT > > rule;
     std::unique_ptr< GenericRule< MoveT > > playout_rule;
     double exploration;
+    PlayoutPolicy< MoveT > playout_policy;
+    // the root position, the initial rule is the start of the game
+    PositionKey< MoveT > position;
     Node< MoveT > root = { MoveT() };
+    // all nodes except the root, a new generation is started on each move
+    NodeArena< MoveT > arena;
+    // release discarded generations on the background reclaimer
+    bool background_reclamation = true;
     std::vector< std::pair< double, Node< MoveT >* > > values;
-    std::random_device rd;
-    std::mt19937 gen;
+    Random gen;
     std::atomic< bool > stop = false;
 };
 
@@ -1,97 +1,156 @@
 #pragma once
 
 #include "rule.h"
+#include "transposition.h"
+#include "endgame.h"
+#include "extension.h"
+#include "reorder.h"
 
 #include <random>
 #include <algorithm>
 #include <optional>
-
-template< typename MoveT >
-using ReOrder = std::function< void (
-    GenericRule< MoveT >& rule,
-    Player,
-    typename std::vector< MoveT >::iterator begin,
-    typename std::vector< MoveT >::iterator end) >;
-
-template< typename MoveT >
-struct Shuffle
-{
-    Shuffle() : g_(rd_()) {}
-
-    void operator()( GenericRule< MoveT >&, Player,
-                     typename std::vector< MoveT >::iterator begin,
-                     typename std::vector< MoveT >::iterator end)
-    {
-        std::shuffle( begin, end, g_ );
-    }
-
-    std::random_device rd_;
-    std::mt19937 g_;
-};
-
-template< typename MoveT >
-struct ReorderByScore
+#include <array>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <cmath>
+
+/* forward pruning near the horizon and late move reductions, each can be
+   switched on separately. Margins are in units of the evaluation function
+   and scaled by the remaining depth. */
+struct ForwardPruning
 {
-    ReorderByScore( std::function< double (GenericRule< MoveT >&, Player) > eval )
-        : eval( eval ) {}
-
-    void operator()( GenericRule< MoveT >& rule, Player player,
-                     typename std::vector< MoveT >::iterator begin,
-                     typename std::vector< MoveT >::iterator end )
-    {
-        shuffle( rule, player, begin, end );
-        scores.clear();
-        for (auto itr = begin; itr != end; ++itr)
-        {
-            rule.apply_move( *itr, player );
-            scores.push_back( std::make_pair( eval( rule, player ), *itr ));
-            rule.undo_move( *itr, player );
-        }
-
-        std::function< bool (std::pair< double, MoveT >,
-                             std::pair< double, MoveT >) > pred;
-        if (player == player1)
-            pred = [](auto lhs, auto rhs) { return lhs.first > rhs.first; };
-        else
-            pred = [](auto lhs, auto rhs) { return lhs.first < rhs.first; };
-        sort( scores.begin(), scores.end(), pred );
-
-        auto itr2 = scores.begin();
-        for (auto itr = begin; itr != end; ++itr, ++itr2)
-            *itr = itr2->second;
-    }
-
-    std::function< double (GenericRule< MoveT >&, Player) > eval;
-    Shuffle< MoveT > shuffle;
-    std::vector< std::pair< double, MoveT > > scores;
+    // moves after the first lmr_full_moves are searched with reduced depth
+    // and searched again with full depth if they raise alpha
+    bool late_move_reductions = false;
+    size_t lmr_min_depth = 3;
+    size_t lmr_full_moves = 3;
+    size_t lmr_reduction = 1;
+
+    // skip moves, except the first, if the static evaluation after the
+    // move plus the margin does not raise alpha
+    bool futility_pruning = false;
+    size_t futility_depth = 2;
+    double futility_margin = 9.0;
+
+    // fail low without search if the static evaluation plus the margin does
+    // not raise alpha
+    bool razoring = false;
+    size_t razoring_depth = 1;
+    double razoring_margin = 18.0;
 };
 
 template< typename MoveT >
 struct Negamax
 {
     Negamax( GenericRule< MoveT > const& initial_rule, std::function< double (GenericRule< MoveT >&, Player) > eval,
-             ReOrder< MoveT > reorder ) 
-    : rule( initial_rule.clone()), eval( eval ), reorder( reorder ) {}
+             ReOrder< MoveT > reorder, std::shared_ptr< ReorderByHistory< MoveT > > history = nullptr,
+             std::shared_ptr< TranspositionTable< MoveT > > tt = nullptr ) 
+    : rule( initial_rule.clone()), eval( eval ), reorder( reorder ), history( history ), 
+      tt( tt ? tt : std::make_shared< TranspositionTable< MoveT > >( default_tt_bits )) {}
+
+    static constexpr size_t default_tt_bits = 20;
+    static constexpr size_t max_pv_ply = 128;
 
     std::unique_ptr< GenericRule< MoveT > > rule;
     std::function< double (GenericRule< MoveT >&, Player) > eval;
     ReOrder< MoveT > reorder;
+    // optional, has to be informed about the node context and cutoffs
+    std::shared_ptr< ReorderByHistory< MoveT > > history;
+    // may be shared with other search threads
+    std::shared_ptr< TranspositionTable< MoveT > > tt;
+    PositionKey< MoveT > position;
     std::vector< MoveT > moves;
 
-    size_t count = 0;
+    ForwardPruning pruning;
+    ForcingExtensions< MoveT > forcing;
+    // optional, takes over below its threshold of empty cells
+    std::shared_ptr< EndgameSolver< MoveT > > endgame;
+    // root moves not to search, for multi pv analysis
+    std::vector< MoveT > excluded;
+    // triangular table, the principal variation of ply p is pv[p][p..pv_length[p])
+    std::array< std::array< MoveT, max_pv_ply >, max_pv_ply > pv;
+    std::array< size_t, max_pv_ply > pv_length {};
+
+    // polled by other threads while the search runs
+    std::atomic< size_t > count = 0;
     size_t max_moves = 0;
+    // forward pruning statistics, cleared per search with clear_statistics()
+    std::atomic< size_t > reductions = 0;
+    std::atomic< size_t > researches = 0;
+    std::atomic< size_t > pruned = 0;
+    size_t solved = 0;
+    size_t extensions = 0;
+    // extended plies of the current line
+    size_t extended = 0;
+    size_t ply = 0;
     std::atomic< bool > stop = false;
 
     double operator()( size_t depth, Player player )
+    {
+        return search( depth, player2_won, player1_won, player );
+    }
+
+    // root search with window, the best move is moves.front() afterwards
+    double search( size_t depth, double alpha, double beta, Player player )
     {
         moves.clear();
+        ply = 0;
+        extended = 0;
+        if (history)
+            history->age();
 
-        return rec( depth, player2_won, player1_won, player );
+        return rec( depth, alpha, beta, player );
+    }
+
+    // keep the position key in sync with the rule
+    void apply_move( MoveT const& move, Player player )
+    {
+        rule->apply_move( move, player );
+        position.apply_move( move, player );
+    }
+
+    void undo_move( MoveT const& move, Player player )
+    {
+        rule->undo_move( move, player );
+        position.undo_move( move, player );
+    }
+
+    void clear_statistics()
+    {
+        reductions = 0;
+        researches = 0;
+        pruned = 0;
+    }
+
+    void reset( GenericRule< MoveT > const& initial_rule )
+    {
+        rule->copy_from( initial_rule );
+        position.reset();
+        moves.clear();
+        tt->clear();
+    }
+
+    std::optional< MoveT > prev_move() const
+    {
+        if (position.line.empty())
+            return {};
+        return position.line.back();
+    }
+
+    // principal variation of the last search
+    std::vector< MoveT > principal_variation() const
+    {
+        return std::vector< MoveT >( pv[0].begin(), pv[0].begin() + pv_length[0] );
     }
 
     double rec( size_t depth, double alpha, double beta, Player player )
     {
-        ++count;
+        count.fetch_add( 1, std::memory_order_relaxed );
+        if (ply < max_pv_ply)
+            pv_length[ply] = ply;
 
         if (stop)
             return 0.0;
@@ -101,12 +160,46 @@ struct Negamax
         if (winner != not_set)
             return player * winner * player1_won;
 
+        // the exact result is known below the root, the root needs a best move
+        if (endgame && ply && endgame->applies( *rule ))
+        {
+            ++solved;
+            const std::optional< int > score = endgame->solve( *rule, position, player, stop );
+            if (!score || !*score)
+                return 0.0;
+            return *score > 0 ? player1_won : player2_won;
+        }
+
+        // probe transposition table, do not cut off at the root, we need the best move
+        std::optional< MoveT > tt_move;
+        if (auto entry = tt->probe( position.key ))
+        {
+            if (entry->has_move)
+                tt_move = entry->move;
+            if (ply && entry->depth >= depth)
+            {
+                if (entry->bound == Exact)
+                    return entry->value;
+                else if (entry->bound == LowerBound)
+                    alpha = std::max( alpha, entry->value );
+                else
+                    beta = std::min( beta, entry->value );
+                if (alpha >= beta)
+                    return entry->value;
+            }
+        }
+        const double alpha_orig = alpha;
+
         // save previous count of moves
         const size_t prev_size = moves.size();
         {
             auto& tmp = rule->generate_moves();
             moves.insert( moves.end(), tmp.begin(), tmp.end());
         }
+        if (!ply && !excluded.empty())
+            moves.erase( std::remove_if( moves.begin() + prev_size, moves.end(), [this](MoveT const& move)
+                { return std::find( excluded.begin(), excluded.end(), move ) != excluded.end(); }),
+                moves.end());
         const size_t new_size = moves.size();
 
         // if no moves generated, we are done
@@ -117,20 +210,81 @@ struct Negamax
         if (!depth)
             return player * eval( *rule, player );
 
+        if (pruning.razoring && ply && depth <= pruning.razoring_depth)
+        {
+            const double static_value = player * eval( *rule, player );
+            if (static_value + pruning.razoring_margin * depth <= alpha)
+            {
+                pruned.fetch_add( 1, std::memory_order_relaxed );
+                return static_value;
+            }
+        }
+
         // apply reordering of generated moves
+        std::optional< MoveT > prev = prev_move();
+        if (history)
+            history->set_node( ply, prev );
         reorder( *rule, player, moves.begin() + prev_size, moves.end());
 
+        // try the move from the transposition table first
+        if (tt_move)
+        {
+            auto itr = std::find( moves.begin() + prev_size, moves.end(), *tt_move );
+            if (itr != moves.end())
+                std::rotate( moves.begin() + prev_size, itr, itr + 1 );
+        }
+
         double value = player2_won;
         size_t best_move = prev_size;
         size_t idx = prev_size;
         for (; idx != new_size; ++idx)
         {
-            rule->apply_move( moves[idx], player );
+            const size_t move_number = idx - prev_size;
+            apply_move( moves[idx], player );
+
+            // forcing moves do not count against the depth
+            const bool extend = forcing.extends( *rule, moves[idx], extended );
+            const size_t child_depth = extend ? depth : depth - 1;
+
+            if (   pruning.futility_pruning && ply && move_number && !extend
+                && depth <= pruning.futility_depth && rule->get_winner() == not_set)
+            {
+                const double static_value = player * eval( *rule, Player( -player ));
+                if (static_value + pruning.futility_margin * depth <= alpha)
+                {
+                    undo_move( moves[idx], player );
+                    pruned.fetch_add( 1, std::memory_order_relaxed );
+                    continue;
+                }
+            }
 
-            const double new_value =
-                -rec( depth - 1, -beta, -alpha, Player( -player ));
+            ++ply;
+            if (extend)
+            {
+                ++extended;
+                ++extensions;
+            }
+            double new_value;
+            if (   pruning.late_move_reductions && depth >= pruning.lmr_min_depth 
+                && move_number >= pruning.lmr_full_moves && !extend)
+            {
+                reductions.fetch_add( 1, std::memory_order_relaxed );
+                const size_t reduced_depth = depth - 1 - std::min( pruning.lmr_reduction, depth - 1 );
+                new_value = -rec( reduced_depth, -beta, -alpha, Player( -player ));
+                if (new_value > alpha)
+                {
+                    researches.fetch_add( 1, std::memory_order_relaxed );
+                    moves.resize( new_size );
+                    new_value = -rec( depth - 1, -beta, -alpha, Player( -player ));
+                }
+            }
+            else
+                new_value = -rec( child_depth, -beta, -alpha, Player( -player ));
+            if (extend)
+                --extended;
+            --ply;
 
-            rule->undo_move( moves[idx], player );
+            undo_move( moves[idx], player );
 
             if (moves.size() > max_moves)
                 max_moves = moves.size();
@@ -141,16 +295,315 @@ struct Negamax
             {
                 value = new_value;
                 best_move = idx;
+                if (value > alpha)
+                    update_pv( moves[idx] );
             }
 
             alpha = std::max( alpha, value );
 
             if (alpha >= beta)
+            {
+                if (history)
+                    history->cutoff( moves[idx], player, depth, ply, prev );
                 break;
+            }
         }
 
         iter_swap( moves.begin() + prev_size, moves.begin() + best_move );
 
+        // the value of a root without the excluded moves is not the value of the position
+        if (!stop && (ply || excluded.empty()))
+            tt->store( position.key, value, &moves[prev_size], depth,
+                      value <= alpha_orig ? UpperBound : value >= beta ? LowerBound : Exact );
+
         return value;
     }
+
+    // prepend move to the principal variation of the next ply
+    void update_pv( MoveT const& move )
+    {
+        if (ply + 1 >= max_pv_ply)
+            return;
+        auto& line = pv[ply];
+        line[ply] = move;
+        const size_t length = std::max( pv_length[ply + 1], ply + 1 );
+        std::copy( pv[ply + 1].begin() + ply + 1, pv[ply + 1].begin() + length, line.begin() + ply + 1 );
+        pv_length[ply] = length;
+    }
+};
+
+/* lazy SMP: helper threads search the same root as the main search with
+   their own rule clones and move ordering, but share the lock-free
+   transposition table. Helpers search with depth offsets and a perturbed
+   root move order, the results they leave in the table speed up the main
+   search. */
+template< typename MoveT >
+struct LazySmp
+{
+    LazySmp( Negamax< MoveT >& main, size_t threads ) : main( main )
+    {
+        for (size_t idx = 1; idx < threads; ++idx)
+        {
+            auto history = std::make_shared< ReorderByHistory< MoveT > >();
+            ReOrder< MoveT > reorder = [history, idx](auto& rule, auto player, auto begin, auto end)
+            {
+                (*history)( rule, player, begin, end );
+                // perturb root move order
+                if (!history->ply && end - begin > 1)
+                    std::rotate( begin, begin + idx % (end - begin), end );
+            };
+            helpers.emplace_back( 
+                std::make_unique< Negamax< MoveT > >( *main.rule, main.eval, reorder, history, main.tt ));
+        }
+    }
+
+    // iterative deepening of the main search up to depth while the helpers are running
+    double operator()( size_t depth, Player player )
+    {
+        if (helpers.empty())
+            return main( depth, player );
+
+        // before any thread starts, a stop arriving meanwhile reaches all helpers
+        for (auto& helper : helpers)
+        {
+            helper->rule->copy_from( *main.rule );
+            helper->position = main.position;
+            helper->pruning = main.pruning;
+            helper->forcing = main.forcing;
+            helper->endgame = main.endgame ? main.endgame->fork() : nullptr;
+            helper->stop = main.stop.load();
+        }
+
+        std::vector< std::thread > threads;
+        for (size_t idx = 0; idx != helpers.size(); ++idx)
+        {
+            Negamax< MoveT >& helper = *helpers[idx];
+            const size_t offset = idx % 2;
+            threads.emplace_back( [&helper, depth, offset, player]()
+            {
+                for (size_t d = 1 + offset; d <= depth + offset && !helper.stop; ++d)
+                    helper( d, player );
+            });
+        }
+
+        double value = 0.0;
+        for (size_t d = 1; d <= depth && !main.stop; ++d)
+            value = main( d, player );
+
+        stop_helpers();
+        for (auto& thread : threads)
+            thread.join();
+
+        return value;
+    }
+
+    void stop_helpers()
+    {
+        for (auto& helper : helpers)
+            helper->stop = true;
+    }
+
+    // visited nodes of all threads
+    size_t count() const
+    {
+        size_t result = main.count.load( std::memory_order_relaxed );
+        for (auto& helper : helpers)
+            result += helper->count.load( std::memory_order_relaxed );
+        return result;
+    }
+
+    Negamax< MoveT >& main;
+    std::vector< std::unique_ptr< Negamax< MoveT > > > helpers;
+};
+
+/* MTD(f) driver, converges to the minimax value with a series of zero
+   window searches relying on the transposition table. Each depth of the
+   iterative deepening is seeded with the value of a previous one. The
+   zero window width is step, for an evaluation with integral values a
+   step of 1 yields the exact value. */
+template< typename MoveT >
+struct Mtdf
+{
+    struct Pass
+    {
+        size_t depth;
+        double beta;
+        double value;
+        size_t nodes;
+    };
+
+    Mtdf( Negamax< MoveT >& negamax, double step = 1.0 ) : negamax( negamax ), step( step ) {}
+
+    double operator()( size_t depth, Player player )
+    {
+        passes.clear();
+        pass_count = 0;
+        nodes = 0;
+        best_move.reset();
+
+        // the evaluation oscillates with the side to move at the horizon, seed
+        // with the value of the last iteration of the same parity
+        double value = 0.0;
+        for (size_t d = 1; d <= depth && !negamax.stop; ++d)
+            value = guesses[d % 2] = search( d, guesses[d % 2], player );
+
+        return value;
+    }
+
+    double search( size_t depth, double g, Player player )
+    {
+        double lower = player2_won;
+        double upper = player1_won;
+        // a won or lost guess would give an empty window
+        if (!std::isfinite( g ))
+            g = 0.0;
+
+        // the move of this depth, a depth without one must not keep the
+        // move of a shallower depth
+        std::optional< MoveT > move;
+        while (lower < upper && !negamax.stop)
+        {
+            const double beta = g == lower ? g + step : g;
+            const size_t count = negamax.count;
+
+            g = negamax.search( depth, beta - step, beta, player );
+
+            passes.push_back( Pass { depth, beta, g, negamax.count - count } );
+            ++pass_count;
+            nodes += negamax.count - count;
+
+            if (g < beta)
+                upper = g;
+            else
+            {
+                lower = g;
+                // only a fail high proves the root move
+                if (!negamax.moves.empty())
+                    move = negamax.moves.front();
+            }
+        }
+
+        // a stopped depth keeps the move of the last depth, a completed depth
+        // without a fail high has every move lost
+        if (move)
+            best_move = move;
+        else if ((!negamax.stop || !best_move) && !negamax.moves.empty())
+            best_move = negamax.moves.front();
+
+        return g;
+    }
+
+    Negamax< MoveT >& negamax;
+    const double step;
+    std::array< double, 2 > guesses { 0.0, 0.0 };
+    std::optional< MoveT > best_move;
+    std::vector< Pass > passes;
+    std::atomic< size_t > pass_count = 0;
+    std::atomic< size_t > nodes = 0;
+};
+
+/* multi pv analysis, iterative deepening with the best lines of the root.
+   At each depth the i-th line is searched with a full window excluding the
+   root moves of the better lines, so all scores are exact. Principal
+   variations cut short by table hits are completed from the transposition
+   table. The lines of the deepest completed depth can be read while the
+   search is running, it runs until max_depth or until stopped. */
+template< typename MoveT >
+struct MultiPv
+{
+    struct Line
+    {
+        double value;
+        std::vector< MoveT > pv;
+    };
+
+    MultiPv( Negamax< MoveT >& negamax, size_t max_lines ) : negamax( negamax ), max_lines( max_lines ) {}
+
+    std::vector< Line > operator()( size_t max_depth, Player player )
+    {
+        {
+            std::lock_guard< std::mutex > lock( mutex );
+            lines.clear();
+        }
+        depth = 0;
+
+        if (negamax.rule->get_winner() != not_set)
+            return {};
+        const size_t root_moves = negamax.rule->generate_moves().size();
+
+        for (size_t d = 1; d <= max_depth && !negamax.stop; ++d)
+        {
+            std::vector< Line > result;
+            negamax.excluded.clear();
+            while (result.size() < std::min( max_lines, root_moves ) && !negamax.stop)
+            {
+                const double value = negamax( d, player );
+                if (negamax.stop)
+                    break;
+
+                std::vector< MoveT > pv = negamax.principal_variation();
+                // every move is lost, there is no principal variation
+                if (pv.empty())
+                    pv.push_back( negamax.moves.front());
+                complete( pv, d, player );
+
+                negamax.excluded.push_back( pv.front());
+                result.push_back( Line { value, pv });
+            }
+            negamax.excluded.clear();
+
+            if (negamax.stop)
+                break;
+
+            std::lock_guard< std::mutex > lock( mutex );
+            lines = result;
+            depth = d;
+        }
+
+        return get_lines();
+    }
+
+    std::vector< Line > get_lines() const
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        return lines;
+    }
+
+    // follow the transposition table moves up to depth plies
+    void complete( std::vector< MoveT >& pv, size_t depth, Player player )
+    {
+        Player current = player;
+        for (MoveT const& move : pv)
+        {
+            negamax.apply_move( move, current );
+            current = Player( -current );
+        }
+
+        while (pv.size() < depth && negamax.rule->get_winner() == not_set)
+        {
+            auto entry = negamax.tt->probe( negamax.position.key );
+            if (!entry || !entry->has_move)
+                break;
+            auto& moves = negamax.rule->generate_moves();
+            if (std::find( moves.begin(), moves.end(), entry->move ) == moves.end())
+                break;
+            negamax.apply_move( entry->move, current );
+            pv.push_back( entry->move );
+            current = Player( -current );
+        }
+
+        for (auto itr = pv.rbegin(); itr != pv.rend(); ++itr)
+        {
+            current = Player( -current );
+            negamax.undo_move( *itr, current );
+        }
+    }
+
+    Negamax< MoveT >& negamax;
+    const size_t max_lines;
+    // the deepest completed depth
+    std::atomic< size_t > depth = 0;
+private:
+    mutable std::mutex mutex;
+    std::vector< Line > lines;
 };
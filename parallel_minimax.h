@@ -0,0 +1,252 @@
+#pragma once
+
+#include "minimax.h"
+
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <tuple>
+
+/* root splitting for the persistent minimax tree. Each helper thread has its
+   own rule clone and its own vertex arena, it owns the subtrees of some root
+   children for the whole search. In each pass the best child of the previous
+   pass is searched first, then the helpers search their other children in
+   parallel with the bounds found so far. The values are merged at the root
+   with the prune functions of the sequential search. The helpers search
+   copies of the root children kept in a side table, the root children in
+   the main arena only take over their values, so all indices of the main
+   tree stay valid while the search runs. After the search the subtrees are
+   copied back to a new generation of the main arena, so the tree looks like
+   the tree of a sequential search. With transpositions the search runs on
+   the main thread. */
+template< typename MoveT >
+struct ParallelMinimax
+{
+    ParallelMinimax( Minimax< MoveT >& main, size_t threads ) : main( main )
+    {
+        for (size_t idx = 0; threads > 1 && idx != threads; ++idx)
+        {
+            helpers.emplace_back(
+                std::make_unique< Minimax< MoveT > >( *main.rule, main.eval, main.recursion ));
+            helpers.back()->main_search = &main;
+            helpers.back()->reclaiming = main.reclaiming;
+        }
+        main.threads = std::max< size_t >( helpers.size(), 1 );
+    }
+
+    double operator()( Player player )
+    {
+        // the shared vertices of a dag do not split into subtrees
+        if (helpers.empty() || main.transpositions)
+            return main( player );
+
+        main.rec_count = 0;
+        main.vertex_count = 0;
+        main.recursion.start( main );
+        if (main.ordering == HistoryOrdering)
+            main.by_history.age();
+        for (auto& helper : helpers)
+        {
+            helper->rule->copy_from( *main.rule );
+            helper->forcing = main.forcing;
+            // each helper learns its own history
+            helper->ordering = main.ordering;
+            helper->by_score.noise = main.by_score.noise;
+            if (helper->ordering == HistoryOrdering)
+                helper->by_history.age();
+            helper->background_reclamation = main.background_reclamation;
+            helper->stop = main.stop.load();
+        }
+
+        do
+        {
+            main.depth = 1;
+            main.extended = 0;
+            // a new or known root does not touch the subtrees of the helpers
+            if (   !main.root.child_count || main.root.is_terminal
+                || main.is_decided( main.root, player2_won, player1_won ))
+                main.rec( player2_won, player1_won, player, main.root );
+            else
+                pass( player );
+            main.depth = 0;
+        } while (main.recursion( main ) == Continue);
+
+        collect();
+
+        return main.root.value();
+    }
+
+    // one pass at the root, the root children are already expanded
+    void pass( Player player )
+    {
+        auto range = main.children( main.root );
+        for (Vertex< MoveT >& child : range)
+            adopt( child );
+
+        for (auto& helper : helpers)
+        {
+            helper->rec_count = 0;
+            helper->reused = 0;
+            helper->extensions = 0;
+        }
+
+        typename Minimax< MoveT >::Prune prune;
+        typename Minimax< MoveT >::Pred pred;
+        double value;
+        std::tie( prune, pred, value ) = Minimax< MoveT >::strategy( player );
+        double alpha = player2_won;
+        double beta = player1_won;
+        bool hard_stop = false;
+        bool done = false;
+        bool is_terminal = true;
+        size_t min_depth = Minimax< MoveT >::max_vertex_depth;
+        size_t searched = 0;
+        std::mutex mutex;
+
+        // search a child with the bounds found so far and merge its value
+        auto search = [&]( Minimax< MoveT >& helper, Vertex< MoveT >& child )
+        {
+            double a, b;
+            {
+                std::lock_guard< std::mutex > lock( mutex );
+                if (done)
+                    return false;
+                a = alpha;
+                b = beta;
+            }
+            helper.depth = main.depth;
+            helper.extended = main.extended;
+            Vertex< MoveT >& vertex = subtrees.at( child.move ).vertex;
+            const bool stopped = helper.rec_child( a, b, player, vertex );
+            mirror( vertex, child );
+
+            std::lock_guard< std::mutex > lock( mutex );
+            if (stopped)
+            {
+                hard_stop = done = true;
+                return false;
+            }
+            ++searched;
+            is_terminal &= child.is_terminal;
+            min_depth = std::min< size_t >( min_depth, child.depth );
+            done |= prune( alpha, beta, value, child.value());
+            return true;
+        };
+
+        // the best child of the previous pass sets the bounds for its brothers
+        search( *helpers[subtrees.at( range.front().move ).owner], range.front());
+
+        auto work = [&]( size_t idx )
+        {
+            for (auto itr = range.begin() + 1; itr != range.end(); ++itr)
+                if (subtrees.at( itr->move ).owner == idx && !search( *helpers[idx], *itr ))
+                    return;
+        };
+
+        if (!done)
+        {
+            std::vector< std::thread > threads;
+            for (size_t idx = 1; idx != helpers.size(); ++idx)
+                threads.emplace_back( work, idx );
+            work( 0 );
+            for (auto& thread : threads)
+                thread.join();
+        }
+
+        for (auto& helper : helpers)
+        {
+            main.rec_count += helper->rec_count;
+            main.reused += helper->reused;
+            main.extensions += helper->extensions;
+        }
+        ++main.rec_count;
+
+        if (hard_stop)
+            return;
+
+        Vertex< MoveT >& root = main.root;
+        root.set_value( value, player2_won, player1_won );
+        root.depth = u_int8_t( std::min( min_depth + 1, Minimax< MoveT >::max_vertex_depth ));
+        // a cutoff before the last child decides only a won or lost position
+        root.is_terminal = is_terminal && (searched == range.size() || root.is_exact());
+        Minimax< MoveT >::sort( range, pred );
+    }
+
+    // copy the subtree of a root child not owned yet to the arena of a helper
+    void adopt( Vertex< MoveT > const& child )
+    {
+        if (subtrees.count( child.move ))
+            return;
+        Subtree subtree { subtrees.size() % helpers.size(), child };
+        VertexArena< MoveT >& arena = helpers[subtree.owner]->arena;
+        const size_t bytes = arena.bytes();
+        main.copy_children( subtree.vertex, arena );
+        main.memory += arena.bytes() - bytes;
+        subtrees.emplace( child.move, subtree );
+    }
+
+    // the result of a helper search without the children in the helper arena
+    static void mirror( Vertex< MoveT > const& from, Vertex< MoveT >& to )
+    {
+        to.lower = from.lower;
+        to.upper = from.upper;
+        to.depth = from.depth;
+        to.is_terminal = from.is_terminal;
+    }
+
+    // copy the subtrees of the helpers back to a new generation of the main arena
+    void collect()
+    {
+        if (subtrees.empty())
+            return;
+
+        VertexArena< MoveT > next;
+        Vertex< MoveT >& root = main.root;
+        const u_int32_t first = next.allocate( root.child_count );
+        for (size_t idx = 0; idx != root.child_count; ++idx)
+        {
+            Vertex< MoveT >& child = next[first + idx];
+            child = main.arena[root.children + idx];
+            auto itr = subtrees.find( child.move );
+            if (itr == subtrees.end())
+                main.copy_children( child, next );
+            else
+            {
+                child = itr->second.vertex;
+                helpers[itr->second.owner]->copy_children( child, next );
+            }
+        }
+        root.children = first;
+        main.arena.swap( next );
+        main.release( std::move( next ));
+
+        for (auto& helper : helpers)
+        {
+            helper->release( std::move( helper->arena ));
+            helper->arena.clear();
+        }
+        subtrees.clear();
+        main.count_bytes();
+    }
+
+    void stop_helpers()
+    {
+        for (auto& helper : helpers)
+            helper->stop = true;
+    }
+
+    Minimax< MoveT >& main;
+    std::vector< std::unique_ptr< Minimax< MoveT > > > helpers;
+    // a root child searched by a helper, its children are in the arena of the owner
+    struct Subtree
+    {
+        size_t owner;
+        Vertex< MoveT > vertex;
+    };
+
+    // the searched root children by move
+    std::map< MoveT, Subtree > subtrees;
+};
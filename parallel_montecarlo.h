@@ -0,0 +1,521 @@
+#pragma once
+
+#include "montecarlo.h"
+
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+namespace montecarlo {
+
+enum Parallelization { TreeParallelization, RootParallelization, LeafParallelization };
+
+/* the statistics of a node are plain fields, so nodes stay trivially
+   copyable for the tree files. The parallel searches access them with
+   these relaxed atomic operations. */
+template< typename T >
+T load_relaxed( T const& field )
+{
+    T value;
+    __atomic_load( &field, &value, __ATOMIC_RELAXED );
+    return value;
+}
+
+inline void add_relaxed( u_int32_t& field, u_int32_t delta )
+{
+    __atomic_fetch_add( &field, delta, __ATOMIC_RELAXED );
+}
+
+inline void sub_relaxed( u_int32_t& field, u_int32_t delta )
+{
+    __atomic_fetch_sub( &field, delta, __ATOMIC_RELAXED );
+}
+
+/* tree parallelization. The threads run simulations on the shared tree of
+   the main search, each with its own rule clones and random generator. A
+   virtual loss is added to the nodes of a line while it is simulated, so
+   the other threads prefer other lines. A new node is expanded by the first
+   thread claiming it, the others wait until its children are published.
+   The tree is the tree of the sequential search and needs no merging. */
+template< typename MoveT >
+struct TreeParallelMCTS
+{
+    TreeParallelMCTS( MCTS< MoveT >& main, size_t threads ) : main( main )
+    {
+        for (size_t idx = 0; threads > 1 && idx != threads; ++idx)
+            workers.emplace_back( std::make_unique< MCTS< MoveT > >( *main.rule, main.exploration ));
+    }
+
+    void operator()( size_t simulations, Player player )
+    {
+        if (workers.empty())
+            return main( simulations, player );
+
+        main.arena.reserve_blocks();
+        for (auto& worker : workers)
+        {
+            worker->rule->copy_from( *main.rule );
+            worker->exploration = main.exploration;
+            worker->playout_policy = main.playout_policy;
+        }
+
+        std::atomic< size_t > started = 0;
+        auto work = [&]( MCTS< MoveT >& worker )
+        {
+            while (!main.stop && !is_decided( main.root ) && started++ < simulations)
+                simulate( worker, main.root, player );
+        };
+
+        std::vector< std::thread > threads;
+        for (size_t idx = 1; idx != workers.size(); ++idx)
+            threads.emplace_back( work, std::ref( *workers[idx] ));
+        work( *workers.front());
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    Player simulate( MCTS< MoveT >& worker, Node< MoveT >& node, Player player )
+    {
+        Player winner;
+        u_int8_t result;
+        if (claim( node ))
+            winner = expand( worker, node, player );
+        else if ((result = load_relaxed( node.terminal )) != Node< MoveT >::no_result)
+            winner = Node< MoveT >::winner( result );
+        else
+        {
+            Node< MoveT >& child = select( worker, node );
+            add_virtual_loss( child );
+            worker.rule->apply_move( child.move, player );
+            winner = simulate( worker, child, Player( -player ));
+            worker.rule->undo_move( child.move, player );
+            remove_virtual_loss( child );
+            if (load_relaxed( child.terminal ) != Node< MoveT >::no_result)
+                prove( node, player );
+        }
+
+        // back propagation
+        add_relaxed( node.denominator, 1 );
+        if (winner == player)
+            add_relaxed( node.half_points, 2 );
+        else if (winner == not_set)
+            add_relaxed( node.half_points, 1 );
+
+        return winner;
+    }
+
+    // true if the thread has to expand the node, else its children or result are known
+    bool claim( Node< MoveT >& node )
+    {
+        u_int8_t expansion = __atomic_load_n( &node.expansion, __ATOMIC_ACQUIRE );
+        if (expansion == Expanded)
+            return false;
+        if (   expansion == Unclaimed
+            && __atomic_compare_exchange_n( &node.expansion, &expansion, u_int8_t( Expanding ), false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE ))
+        {
+            // expanded by a sequential search
+            if (node.child_count || node.is_terminal())
+            {
+                __atomic_store_n( &node.expansion, u_int8_t( Expanded ), __ATOMIC_RELEASE );
+                return false;
+            }
+            return true;
+        }
+
+        // another thread expands the node, that is a short while
+        while (__atomic_load_n( &node.expansion, __ATOMIC_ACQUIRE ) != Expanded)
+            std::this_thread::yield();
+        return false;
+    }
+
+    // expand the claimed node, publish it and play out one of its children
+    Player expand( MCTS< MoveT >& worker, Node< MoveT >& node, Player player )
+    {
+        Player winner = worker.rule->get_winner();
+        std::vector< MoveT >* moves = nullptr;
+        // the selection of other threads reads the result of the children
+        if (winner != not_set) // winner?
+            __atomic_store_n( &node.terminal, Node< MoveT >::result( winner ), __ATOMIC_RELAXED );
+        else
+        {
+            moves = &worker.rule->generate_moves();
+            if (moves->empty()) // draw?
+                __atomic_store_n( &node.terminal, Node< MoveT >::result( not_set ), __ATOMIC_RELAXED );
+            else
+            {
+                assert (moves->size() <= 255);
+                Node< MoveT >* child;
+                {
+                    std::lock_guard< std::mutex > lock( arena_mutex );
+                    node.children = main.arena.allocate( moves->size());
+                    child = &main.arena[node.children];
+                }
+                node.child_count = u_int8_t( moves->size());
+                for (MoveT const& move : *moves)
+                    *child++ = Node< MoveT >( move );
+            }
+        }
+        __atomic_store_n( &node.expansion, u_int8_t( Expanded ), __ATOMIC_RELEASE );
+
+        if (node.child_count)
+            winner = worker.playout( *moves, player );
+        return winner;
+    }
+
+    Node< MoveT >& select( MCTS< MoveT >& worker, Node< MoveT >& node )
+    {
+        assert (node.child_count);
+
+        const size_t visits = load_relaxed( node.denominator );
+        worker.values.clear();
+        for (Node< MoveT >& child : main.children( node ))
+        {
+            // a won child proves the node, so only draws are left of the decided ones
+            const u_int8_t result = load_relaxed( child.terminal );
+            if (result == Node< MoveT >::no_result || Node< MoveT >::winner( result ) == not_set)
+                worker.values.push_back( { MCTS< MoveT >::cbt(
+                    0.5 * load_relaxed( child.half_points ), load_relaxed( child.denominator ), visits, 
+                    main.exploration ), &child });
+        }
+
+        // all children lost, the back propagation proves the node
+        if (worker.values.empty())
+            return main.children( node ).front();
+
+        // mix in some randomness
+        worker.gen.shuffle( worker.values.begin(), worker.values.end());
+
+        auto itr = max_element( worker.values.begin(), worker.values.end(),
+            [](auto& lhs, auto& rhs) { return lhs.first < rhs.first; });
+        return *itr->second;
+    }
+
+    // back up the result of a decided child, other threads may prove the node too
+    void prove( Node< MoveT >& node, Player player )
+    {
+        const u_int8_t result = MCTS< MoveT >::proven( std::as_const( main ).children( node ), player );
+        if (result != Node< MoveT >::no_result)
+            __atomic_store_n( &node.terminal, result, __ATOMIC_RELAXED );
+    }
+
+    // count lost simulations for the player choosing the child until the simulation is back
+    void add_virtual_loss( Node< MoveT >& child )
+    {
+        if (!virtual_loss)
+            return;
+        add_relaxed( child.denominator, virtual_loss );
+        add_relaxed( child.half_points, 2 * virtual_loss );
+    }
+
+    void remove_virtual_loss( Node< MoveT >& child )
+    {
+        if (!virtual_loss)
+            return;
+        sub_relaxed( child.denominator, virtual_loss );
+        sub_relaxed( child.half_points, 2 * virtual_loss );
+    }
+
+    static bool is_decided( Node< MoveT > const& node )
+    {
+        return    __atomic_load_n( &node.expansion, __ATOMIC_ACQUIRE ) == Expanded 
+               && load_relaxed( node.terminal ) != Node< MoveT >::no_result;
+    }
+
+    MCTS< MoveT >& main;
+    std::vector< std::unique_ptr< MCTS< MoveT > > > workers;
+    // lost simulations added per thread on a line
+    u_int32_t virtual_loss = 1;
+    std::mutex arena_mutex;
+};
+
+/* root parallelization. Independent searches of the same position, each
+   with its own tree, rule clones and random generator, share the
+   simulations of a search. The statistics of their root children are
+   summed to choose the move, the trees are kept for the next move. There
+   is no shared state during the search. */
+template< typename MoveT >
+struct RootParallelMCTS
+{
+    RootParallelMCTS( MCTS< MoveT >& main, size_t threads ) : main( main )
+    {
+        for (size_t idx = 1; idx < threads; ++idx)
+            helpers.emplace_back( std::make_unique< MCTS< MoveT > >( *main.rule, main.exploration ));
+    }
+
+    void operator()( size_t simulations, Player player )
+    {
+        if (helpers.empty())
+            return main( simulations, player );
+
+        for (auto& helper : helpers)
+        {
+            helper->exploration = main.exploration;
+            helper->playout_policy = main.playout_policy;
+            helper->stop = main.stop.load();
+        }
+
+        // the main search takes the remainder
+        const size_t share = simulations / (helpers.size() + 1);
+        std::vector< std::thread > threads;
+        for (auto& helper : helpers)
+            threads.emplace_back( [&helper, share, player]() { (*helper)( share, player ); });
+        main( simulations - share * helpers.size(), player );
+        for (auto& thread : threads)
+            thread.join();
+
+        merge();
+    }
+
+    // sum the statistics of the root children of all searches
+    void merge()
+    {
+        auto range = std::as_const( main ).children( main.root );
+        merged.assign( range.begin(), range.end());
+        for (auto const& helper : helpers)
+            for (Node< MoveT > const& child : std::as_const( *helper ).children( helper->root ))
+            {
+                auto itr = std::find_if( merged.begin(), merged.end(),
+                    [&child]( Node< MoveT > const& node ) { return node.move == child.move; });
+                if (itr == merged.end())
+                    continue;
+                itr->half_points += child.half_points;
+                itr->denominator += child.denominator;
+                if (child.is_terminal())
+                    itr->terminal = child.terminal;
+            }
+    }
+
+    // root children to choose the move from
+    NodeRange< MoveT > children() const
+    {
+        if (helpers.empty())
+            return std::as_const( main ).children( main.root );
+        return { merged.data(), merged.data() + merged.size() };
+    }
+
+    void apply_move( MoveT const& move, Player player )
+    {
+        main.apply_move( move, player );
+        for (auto& helper : helpers)
+            helper->apply_move( move, player );
+        merged.clear();
+    }
+
+    void init( GenericRule< MoveT > const& rule )
+    {
+        main.init( rule );
+        for (auto& helper : helpers)
+            helper->init( rule );
+        merged.clear();
+    }
+
+    void stop_helpers()
+    {
+        for (auto& helper : helpers)
+            helper->stop = true;
+    }
+
+    MCTS< MoveT >& main;
+    std::vector< std::unique_ptr< MCTS< MoveT > > > helpers;
+    std::vector< Node< MoveT > > merged;
+};
+
+// summed results of playouts
+struct Playouts
+{
+    void add( Player winner, u_int32_t playouts = 1 )
+    {
+        count += playouts;
+        if (winner == player1)
+            player1_half_points += 2 * playouts;
+        else if (winner == not_set)
+            player1_half_points += playouts;
+    }
+
+    void add( Playouts const& other )
+    {
+        count += other.count;
+        player1_half_points += other.player1_half_points;
+    }
+
+    // half points of player like in the nodes
+    u_int32_t half_points( Player player ) const
+    {
+        return player == player1 ? player1_half_points : 2 * count - player1_half_points;
+    }
+
+    u_int32_t count = 0;
+    u_int32_t player1_half_points = 0;
+};
+
+/* leaf parallelization. The tree is walked on the search thread like in
+   the sequential search, but a new leaf is played out batch times at once.
+   A pool of workers shares the playouts of the batch, each on its own copy
+   of the leaf position, and the summed result is backed up once with every
+   playout counting as a visit. A known result counts as a whole batch. */
+template< typename MoveT >
+struct LeafParallelMCTS
+{
+    LeafParallelMCTS( MCTS< MoveT >& main, size_t threads, size_t batch ) 
+    : main( main ), batch( u_int32_t( std::max< size_t >( batch, 1 ))), results( threads ? threads - 1 : 0 )
+    {
+        for (size_t idx = 1; idx < threads; ++idx)
+            workers.emplace_back( std::make_unique< MCTS< MoveT > >( *main.rule, main.exploration ));
+        for (size_t idx = 0; idx != workers.size(); ++idx)
+            pool.emplace_back( [this, idx]() { run( idx ); });
+    }
+
+    LeafParallelMCTS( LeafParallelMCTS const& ) = delete;
+    LeafParallelMCTS& operator=( LeafParallelMCTS const& ) = delete;
+
+    ~LeafParallelMCTS()
+    {
+        {
+            std::lock_guard< std::mutex > lock( mutex );
+            quit = true;
+        }
+        start.notify_all();
+        for (auto& thread : pool)
+            thread.join();
+    }
+
+    // run at least simulations playouts
+    void operator()( size_t simulations, Player player )
+    {
+        if (workers.empty() && batch == 1)
+            return main( simulations, player );
+
+        // the pool is idle between batches
+        for (auto& worker : workers)
+            worker->playout_policy = main.playout_policy;
+        for (size_t playouts = 0; playouts < simulations && !main.root.is_terminal() && !main.stop;)
+            playouts += simulate( main.root, player ).count;
+    }
+
+    Playouts simulate( Node< MoveT >& node, Player player )
+    {
+        Playouts result;
+        if (node.is_terminal())
+            result.add( node.winner(), batch );
+        else if (!node.child_count)
+        {
+            const Player winner = main.rule->get_winner();
+            if (winner != not_set) // winner?
+            {
+                node.set_terminal( winner );
+                result.add( winner, batch );
+            }
+            else 
+            {
+                auto& moves = main.rule->generate_moves();
+                if (moves.empty()) // draw?
+                {
+                    node.set_terminal( not_set );
+                    result.add( not_set, batch );
+                }
+                else
+                {
+                    main.expand( node, moves );
+                    result = playouts( player );
+                }
+            }
+        }
+        else
+        {
+            Node< MoveT >& child = main.select( node );
+            main.rule->apply_move( child.move, player );
+            result = simulate( child, Player( -player ));
+            main.rule->undo_move( child.move, player );
+            if (child.is_terminal())
+                main.prove( node, player );
+        }
+
+        // back propagation
+        node.denominator += result.count;
+        node.half_points += result.half_points( player );
+
+        return result;
+    }
+
+    // play out the position of the main rule batch times on all workers
+    Playouts playouts( Player player )
+    {
+        {
+            std::lock_guard< std::mutex > lock( mutex );
+            batch_player = player;
+            next = 0;
+            pending = workers.size();
+            ++generation;
+        }
+        start.notify_all();
+
+        Playouts result;
+        play( main, player, result );
+
+        std::unique_lock< std::mutex > lock( mutex );
+        done.wait( lock, [this]() { return !pending; });
+        for (Playouts& worker_result : results)
+        {
+            result.add( worker_result );
+            worker_result = Playouts();
+        }
+        return result;
+    }
+
+    // take playouts of the batch until it is used up, the main rule is not changed meanwhile
+    void play( MCTS< MoveT >& mcts, Player player, Playouts& result )
+    {
+        if (&mcts != &main)
+            mcts.rule->copy_from( *main.rule );
+        while (next++ < batch)
+            // a playout overwrites the moves container
+            result.add( mcts.playout( mcts.rule->generate_moves(), player ));
+    }
+
+    void run( size_t idx )
+    {
+        size_t seen = 0;
+        while (true)
+        {
+            Player player;
+            {
+                std::unique_lock< std::mutex > lock( mutex );
+                start.wait( lock, [this, seen]() { return quit || generation != seen; });
+                if (quit)
+                    return;
+                seen = generation;
+                player = batch_player;
+            }
+            play( *workers[idx], player, results[idx] );
+            {
+                std::lock_guard< std::mutex > lock( mutex );
+                --pending;
+            }
+            done.notify_one();
+        }
+    }
+
+    MCTS< MoveT >& main;
+    // playouts per new leaf
+    const u_int32_t batch;
+    std::vector< std::unique_ptr< MCTS< MoveT > > > workers;
+    // result of the current batch per worker
+    std::vector< Playouts > results;
+    std::atomic< size_t > next = 0;
+    std::mutex mutex;
+    std::condition_variable start;
+    std::condition_variable done;
+    size_t generation = 0;
+    size_t pending = 0;
+    Player batch_player = player1;
+    bool quit = false;
+    std::vector< std::thread > pool;
+};
+
+} // namespace montecarlo {
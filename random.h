@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <random>
+#include <limits>
+#include <utility>
+
+/* fast random numbers for the searches. Every engine owns a small
+   xoshiro256** generator, so each thread draws from its own generator
+   without locking. All generators are seeded from one master seed, it is
+   drawn from the random device unless it is set. With a fixed master seed
+   a run is reproducible, the generators get their seeds in the order of
+   their construction. */
+
+// expands a seed into well mixed words, state advances by each call
+inline std::uint64_t splitmix64( std::uint64_t& state )
+{
+    std::uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+struct SeedSequence
+{
+    SeedSequence()
+    {
+        std::random_device rd;
+        master = std::uint64_t( rd()) << 32 | rd();
+    }
+
+    std::atomic< std::uint64_t > master;
+    // seeds handed out since the master seed was set
+    std::atomic< std::uint64_t > count = 0;
+};
+
+inline SeedSequence seed_sequence;
+
+// seed the generators constructed from now on reproducibly
+inline void set_master_seed( std::uint64_t seed )
+{
+    seed_sequence.master = seed;
+    seed_sequence.count = 0;
+}
+
+inline std::uint64_t next_seed()
+{
+    std::uint64_t state = seed_sequence.master + seed_sequence.count++ * 0x9e3779b97f4a7c15ull;
+    return splitmix64( state );
+}
+
+// xoshiro256**, a uniform random bit generator for the standard algorithms too
+class Random
+{
+public:
+    typedef std::uint64_t result_type;
+
+    explicit Random( std::uint64_t seed = next_seed())
+    {
+        for (std::uint64_t& word : state)
+            word = splitmix64( seed );
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits< result_type >::max(); }
+
+    result_type operator()()
+    {
+        const std::uint64_t result = rotl( state[1] * 5, 7 ) * 9;
+        const std::uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl( state[3], 45 );
+        return result;
+    }
+
+    /* uniform in [0, bound) by a multiplication instead of a division, the
+       bias is below bound / 2^32 */
+    std::uint32_t below( std::uint32_t bound )
+    {
+        return std::uint32_t( ((*this)() >> 32) * bound >> 32 );
+    }
+
+    // uniform in [0, 1)
+    double unit()
+    {
+        return double( (*this)() >> 11 ) * 0x1.0p-53;
+    }
+
+    // fisher yates with the bounded sampling above
+    template< typename Iterator >
+    void shuffle( Iterator begin, Iterator end )
+    {
+        for (auto size = end - begin; size > 1; --size)
+            std::swap( begin[size - 1], begin[below( std::uint32_t( size ))] );
+    }
+private:
+    static std::uint64_t rotl( std::uint64_t x, int k )
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    std::uint64_t state[4];
+};
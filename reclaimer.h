@@ -0,0 +1,90 @@
+#pragma once
+
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+/* releases garbage like the arena generations of discarded search trees on a
+   background thread, so the search thread does not pay for the teardown.
+   Pending garbage is released before destruction completes. */
+class Reclaimer
+{
+public:
+    Reclaimer() : thread( [this]() { run(); }) {}
+
+    Reclaimer( Reclaimer const& ) = delete;
+    Reclaimer& operator=( Reclaimer const& ) = delete;
+
+    ~Reclaimer()
+    {
+        {
+            std::lock_guard< std::mutex > lock( mutex );
+            done = true;
+        }
+        condition.notify_one();
+        thread.join();
+    }
+
+    /* the last reference of garbage is dropped on the background thread.
+       The bytes of the garbage are counted in pending_bytes until then. */
+    void reclaim( std::shared_ptr< void > garbage, size_t bytes = 0,
+                  std::shared_ptr< std::atomic< size_t > > pending_bytes = nullptr )
+    {
+        if (pending_bytes)
+            *pending_bytes += bytes;
+        {
+            std::lock_guard< std::mutex > lock( mutex );
+            queue.push_back( Garbage { std::move( garbage ), bytes, std::move( pending_bytes ) });
+        }
+        condition.notify_one();
+    }
+
+    size_t pending()
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        return queue.size();
+    }
+
+    // shared by all search engines
+    static Reclaimer& instance()
+    {
+        static Reclaimer reclaimer;
+        return reclaimer;
+    }
+private:
+    struct Garbage
+    {
+        std::shared_ptr< void > garbage;
+        size_t bytes;
+        std::shared_ptr< std::atomic< size_t > > pending_bytes;
+    };
+
+    void run()
+    {
+        std::unique_lock< std::mutex > lock( mutex );
+        while (true)
+        {
+            condition.wait( lock, [this]() { return done || !queue.empty(); });
+            if (queue.empty())
+                return;
+            Garbage garbage = std::move( queue.front());
+            queue.pop_front();
+
+            lock.unlock();
+            garbage.garbage.reset();
+            if (garbage.pending_bytes)
+                *garbage.pending_bytes -= garbage.bytes;
+            garbage.pending_bytes.reset();
+            lock.lock();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque< Garbage > queue;
+    bool done = false;
+    std::thread thread;
+};
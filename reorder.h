@@ -0,0 +1,170 @@
+#pragma once
+
+#include "rule.h"
+#include "transposition.h"
+#include "random.h"
+
+#include <algorithm>
+#include <optional>
+#include <array>
+#include <vector>
+#include <functional>
+
+template< typename MoveT >
+using ReOrder = std::function< void (
+    GenericRule< MoveT >& rule,
+    Player,
+    typename std::vector< MoveT >::iterator begin,
+    typename std::vector< MoveT >::iterator end) >;
+
+template< typename MoveT >
+struct Shuffle
+{
+    void operator()( GenericRule< MoveT >&, Player,
+                     typename std::vector< MoveT >::iterator begin,
+                     typename std::vector< MoveT >::iterator end)
+    {
+        g_.shuffle( begin, end );
+    }
+
+    Random g_;
+};
+
+/* order by the evaluation after the move, best first for the player. The
+   scores are perturbed by at most noise for some variety among moves of
+   about the same score. */
+template< typename MoveT >
+struct ReorderByScore
+{
+    ReorderByScore( std::function< double (GenericRule< MoveT >&, Player) > eval, double noise = 0.0 )
+        : eval( eval ), noise( noise ) {}
+
+    void operator()( GenericRule< MoveT >& rule, Player player,
+                     typename std::vector< MoveT >::iterator begin,
+                     typename std::vector< MoveT >::iterator end )
+    {
+        shuffle( rule, player, begin, end );
+        scores.clear();
+        for (auto itr = begin; itr != end; ++itr)
+        {
+            rule.apply_move( *itr, player );
+            double score = eval( rule, player );
+            if (noise > 0.0)
+                score += noise * (2.0 * shuffle.g_.unit() - 1.0);
+            scores.push_back( std::make_pair( score, *itr ));
+            rule.undo_move( *itr, player );
+        }
+
+        if (player == player1)
+            sort( scores.begin(), scores.end(),
+                  [](auto const& lhs, auto const& rhs) { return lhs.first > rhs.first; });
+        else
+            sort( scores.begin(), scores.end(),
+                  [](auto const& lhs, auto const& rhs) { return lhs.first < rhs.first; });
+
+        auto itr2 = scores.begin();
+        for (auto itr = begin; itr != end; ++itr, ++itr2)
+            *itr = itr2->second;
+    }
+
+    std::function< double (GenericRule< MoveT >&, Player) > eval;
+    double noise;
+    Shuffle< MoveT > shuffle;
+    std::vector< std::pair< double, MoveT > > scores;
+};
+
+/* cheap move ordering from the search history: killer moves per ply, a
+   history (butterfly) table indexed by side and cell and a countermove table
+   indexed by side and the previous move. The search has to set the node
+   context before reordering and report beta cutoffs. */
+template< typename MoveT >
+struct ReorderByHistory
+{
+    static constexpr size_t max_ply = 128;
+    static constexpr size_t max_moves = ZobristKeys::max_moves;
+
+    void set_node( size_t _ply, std::optional< MoveT > const& _prev_move )
+    {
+        ply = std::min( _ply, max_ply - 1 );
+        prev_move = _prev_move;
+    }
+
+    void operator()( GenericRule< MoveT >&, Player player,
+                     typename std::vector< MoveT >::iterator begin,
+                     typename std::vector< MoveT >::iterator end )
+    {
+        const size_t side = player == player1 ? 0 : 1;
+        auto const& killer = killers[ply];
+        std::optional< MoveT > counter;
+        if (prev_move)
+            counter = countermoves[side][size_t( *prev_move )];
+
+        scores.clear();
+        for (auto itr = begin; itr != end; ++itr)
+        {
+            u_int32_t score = history[side][size_t( *itr )];
+            if (killer[0] == *itr)
+                score += killer_bonus + 2;
+            else if (killer[1] == *itr)
+                score += killer_bonus + 1;
+            else if (counter == *itr)
+                score += killer_bonus;
+            scores.push_back( score );
+        }
+
+        // insertion sort by descending score, the ranges are small
+        const size_t size = scores.size();
+        for (size_t i = 1; i < size; ++i)
+        {
+            const u_int32_t score = scores[i];
+            const MoveT move = begin[i];
+            size_t j = i;
+            for (; j && scores[j - 1] < score; --j)
+            {
+                scores[j] = scores[j - 1];
+                begin[j] = begin[j - 1];
+            }
+            scores[j] = score;
+            begin[j] = move;
+        }
+    }
+
+    void cutoff( MoveT const& move, Player player, size_t depth, size_t _ply,
+                 std::optional< MoveT > const& _prev_move )
+    {
+        const size_t side = player == player1 ? 0 : 1;
+        auto& killer = killers[std::min( _ply, max_ply - 1 )];
+        if (killer[0] != move)
+        {
+            killer[1] = killer[0];
+            killer[0] = move;
+        }
+        if (_prev_move)
+            countermoves[side][size_t( *_prev_move )] = move;
+
+        u_int32_t& entry = history[side][size_t( move )];
+        entry += u_int32_t( depth * depth );
+        if (entry >= max_history)
+            age();
+    }
+
+    // keep some knowledge from previous searches
+    void age()
+    {
+        for (auto& side : history)
+            for (u_int32_t& entry : side)
+                entry /= 2;
+        for (auto& killer : killers)
+            killer.fill( std::nullopt );
+    }
+
+    static constexpr u_int32_t max_history = 1 << 24;
+    static constexpr u_int32_t killer_bonus = 1 << 25;
+
+    size_t ply = 0;
+    std::optional< MoveT > prev_move;
+    std::array< std::array< std::optional< MoveT >, 2 >, max_ply > killers;
+    std::array< std::array< u_int32_t, max_moves >, 2 > history {};
+    std::array< std::array< std::optional< MoveT >, max_moves >, 2 > countermoves;
+    std::vector< u_int32_t > scores;
+};
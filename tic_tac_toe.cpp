@@ -2,12 +2,13 @@
 
 #include <string>
 #include <cassert>
+#include <algorithm>
 
 using namespace std;
 
 namespace tic_tac_toe {
 
-std::vector< Move > Rule::moves;
+thread_local std::vector< Move > Rule::moves;
 
 Rule::Rule( Player* board ) : board( board ) {}
 
@@ -109,6 +110,13 @@ void Rule::undo_move( Move const& move, Player)
     board[move] = not_set;
 }
 
+size_t empty_cells( Rule const& rule )
+{
+    if (rule.get_winner() != not_set)
+        return 0;
+    return count( rule.board, rule.board + n * n, not_set );
+}
+
 namespace trivial_estimate {
 double eval( Rule const& rule )
 {
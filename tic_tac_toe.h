@@ -23,7 +23,7 @@ struct Rule : public GenericRule< Move >
     void undo_move( Move const&, Player);
 
     Player* board;
-    static std::vector< Move > moves;
+    static thread_local std::vector< Move > moves;
 };
 
 struct DeepRule : public Rule
@@ -35,6 +35,9 @@ struct DeepRule : public Rule
     std::array< Player, n * n > mem;
 };
 
+// number of empty cells, zero if the game is decided
+size_t empty_cells( Rule const& rule );
+
 namespace trivial_estimate {
 double eval( Rule const& rule );
 } // namespace trivial_estimate {
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "player.h"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <optional>
+#include <atomic>
+#include <random>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+
+/* zobrist keys for incremental position hashing. A position is identified by
+   the (move, player) pairs applied since the initial position and the last
+   move, because in ultimate tic tac toe the last move selects the inner board
+   of the next move. Moves are assumed to be small integral values. */
+struct ZobristKeys
+{
+    static constexpr size_t max_moves = 256;
+
+    ZobristKeys()
+    {
+        // fixed seed, keys have to be the same for all instances and runs
+        std::mt19937_64 g( 0x9e3779b97f4a7c15ull );
+        initial = g();
+        for (auto& player_keys : cells)
+            for (auto& key : player_keys)
+                key = g();
+        for (auto& key : last_move)
+            key = g();
+    }
+
+    std::uint64_t cell( size_t move, Player player ) const
+    {
+        assert (move < max_moves);
+        return cells[player == player1 ? 0 : 1][move];
+    }
+
+    std::uint64_t initial;
+    std::array< std::array< std::uint64_t, max_moves >, 2 > cells;
+    std::array< std::uint64_t, max_moves > last_move;
+};
+
+inline const ZobristKeys zobrist_keys;
+
+// incrementally maintained hash key of a position and the line leading to it
+template< typename MoveT >
+struct PositionKey
+{
+    void apply_move( MoveT const& move, Player player )
+    {
+        key ^= zobrist_keys.cell( size_t( move ), player );
+        if (!line.empty())
+            key ^= zobrist_keys.last_move[size_t( line.back())];
+        key ^= zobrist_keys.last_move[size_t( move )];
+        line.push_back( move );
+    }
+
+    void undo_move( MoveT const& move, Player player )
+    {
+        assert (!line.empty() && line.back() == move);
+        line.pop_back();
+        key ^= zobrist_keys.last_move[size_t( move )];
+        if (!line.empty())
+            key ^= zobrist_keys.last_move[size_t( line.back())];
+        key ^= zobrist_keys.cell( size_t( move ), player );
+    }
+
+    void reset()
+    {
+        key = zobrist_keys.initial;
+        line.clear();
+    }
+
+    std::uint64_t key = zobrist_keys.initial;
+    std::vector< MoveT > line;
+};
+
+enum Bound : u_int8_t { Exact, LowerBound, UpperBound };
+
+/* lock-free transposition table to be shared between search threads. Each
+   slot holds the packed entry data and the key xor'ed with the data, so a
+   torn write of another thread is detected as a key mismatch and ignored.
+   Values are stored in single precision. */
+template< typename MoveT >
+struct TranspositionTable
+{
+    struct Entry
+    {
+        double value = 0.0;
+        MoveT move = MoveT();
+        u_int8_t depth = 0;
+        Bound bound = Exact;
+        bool has_move = false;
+    };
+
+    TranspositionTable( size_t bits ) : slots( size_t( 1 ) << bits ), mask( slots.size() - 1 ) {}
+
+    std::optional< Entry > probe( std::uint64_t key ) const
+    {
+        Slot const& slot = slots[key & mask];
+        const std::uint64_t data = slot.data.load( std::memory_order_relaxed );
+        const std::uint64_t check = slot.check.load( std::memory_order_relaxed );
+        if ((check ^ data) != key)
+            return {};
+        return unpack( data );
+    }
+
+    // depth preferred replacement, entries of other positions are always replaced
+    void store( std::uint64_t key, double value, MoveT const* move, size_t depth, Bound bound )
+    {
+        auto entry = probe( key );
+        if (entry && entry->depth > depth)
+            return;
+
+        Slot& slot = slots[key & mask];
+        const std::uint64_t data = pack( value, move, depth, bound );
+        slot.data.store( data, std::memory_order_relaxed );
+        slot.check.store( key ^ data, std::memory_order_relaxed );
+    }
+
+    void clear()
+    {
+        for (Slot& slot : slots)
+        {
+            slot.data.store( 0, std::memory_order_relaxed );
+            slot.check.store( 0, std::memory_order_relaxed );
+        }
+    }
+private:
+    struct Slot
+    {
+        std::atomic< std::uint64_t > check { 0 };
+        std::atomic< std::uint64_t > data { 0 };
+    };
+
+    static std::uint64_t pack( double value, MoveT const* move, size_t depth, Bound bound )
+    {
+        const float fvalue = float( value );
+        std::uint32_t bits;
+        std::memcpy( &bits, &fvalue, sizeof( bits ));
+
+        std::uint64_t data = bits;
+        if (move)
+        {
+            assert (size_t( *move ) < ZobristKeys::max_moves);
+            data |= std::uint64_t( size_t( *move )) << 32 | std::uint64_t( 1 ) << 50;
+        }
+        data |= std::uint64_t( std::min< size_t >( depth, 255 )) << 40;
+        data |= std::uint64_t( bound ) << 48;
+        return data;
+    }
+
+    static Entry unpack( std::uint64_t data )
+    {
+        Entry entry;
+        const std::uint32_t bits = std::uint32_t( data );
+        float fvalue;
+        std::memcpy( &fvalue, &bits, sizeof( fvalue ));
+        entry.value = fvalue;
+        entry.move = MoveT( (data >> 32) & 0xff );
+        entry.depth = u_int8_t( data >> 40 );
+        entry.bound = Bound( (data >> 48) & 0x3 );
+        entry.has_move = (data >> 50) & 1;
+        return entry;
+    }
+
+    std::vector< Slot > slots;
+    const size_t mask;
+};
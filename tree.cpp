@@ -2,6 +2,7 @@
 
 #include <graphviz/cgraph.h>
 #include <graphviz/gvcext.h>
+#include <unordered_map>
 
 using namespace std;
 
@@ -205,7 +206,7 @@ float get_weight( Tree& tree, Agnode_t* gv_node )
     Tree::Data* node_data = (Tree::Data*)aggetrec(gv_node, "data", 0);
     // the template type char is only a placeholder, it is not used
     Vertex< char > const& node = *(Vertex< char >*)node_data->node;
-    return (float) node.value * tree.get_player();
+    return (float) node.value() * tree.get_player();
 }
 
 template< typename MoveT >
@@ -213,31 +214,37 @@ void get_stats( Agraph_t* gv_graph, Agnode_t* gv_node, Tree::Stats& stats )
 {
     Tree::Data* node_data = (Tree::Data*)aggetrec(gv_node, "data", 0);
     Vertex< MoveT > const& node = *(Vertex< MoveT >*)node_data->node;
-    stats.value = node.value;
+    stats.value = node.value();
     stats.depth = node_data->depth;
     stats.is_terminal = node.is_terminal;
     stats.move = to_string( node.move );
 }
 
+// vertices shared by transpositions are added once
 template< typename MoveT >
-Agnode_t* add_node( Agraph_t* gv_graph, Player player, Vertex< MoveT > const& node )
+Agnode_t* add_node( Agraph_t* gv_graph, Player player, Minimax< MoveT > const& minimax, 
+                    Vertex< MoveT > const& node, 
+                    std::unordered_map< Vertex< MoveT > const*, Agnode_t* >& added )
 {
-    Agnode_t* gv_node = agnode(gv_graph, nullptr, true);
+    auto [itr, inserted] = added.try_emplace( &node, nullptr );
+    if (!inserted)
+        return itr->second;
+    Agnode_t* gv_node = itr->second = agnode(gv_graph, nullptr, true);
 
     Tree::Data* data = (Tree::Data*) agbindrec( gv_node, "data", sizeof(Tree::Data), false);
     data->depth = 1;
     data->node = (void*)&node;
 
-    for (Vertex< MoveT > const& child : node.children)
+    for (Vertex< MoveT > const& child : minimax.children( node ))
     {
-        Agnode_t* gv_child = add_node( gv_graph, Player( -player ), child );
+        Agnode_t* gv_child = add_node( gv_graph, Player( -player ), minimax, child, added );
         agedge( gv_graph, gv_node, gv_child, nullptr, true);
 
         Tree::Data* child_data = (Tree::Data*)aggetrec(gv_child, "data", 0);
         if (child_data->depth > data->depth)
             data->depth = child_data->depth;
     }
-    if (!node.children.empty())
+    if (node.child_count)
         ++data->depth;
 
     return gv_node;
@@ -291,10 +298,11 @@ void Tree::set_node_attribute( Agnode_t* gv_node, Player player )
         set_node_attribute( aghead( e ), Player( -player ));
 }
 
-TicTacToeTree::TicTacToeTree( GVC_t* gv_gvc, Player player, Vertex< tic_tac_toe::Move > const& node )
+TicTacToeTree::TicTacToeTree( GVC_t* gv_gvc, Player player, Minimax< tic_tac_toe::Move > const& minimax )
     : Tree( gv_gvc, player ) 
 {
-    add_node( gv_graph, player, node );
+    std::unordered_map< Vertex< tic_tac_toe::Move > const*, Agnode_t* > added;
+    add_node( gv_graph, player, minimax, minimax.root, added );
     gv_focus_node = agfstnode( gv_graph);
 }
 
@@ -305,10 +313,11 @@ void TicTacToeTree::get_stats( Agnode_t* gv_node, Tree::Stats& stats )
     minimax::get_stats< tic_tac_toe::Move >( gv_graph, gv_node, stats );
 }
 
-MetaTicTacToeTree::MetaTicTacToeTree( GVC_t* gv_gvc, Player player, Vertex< meta_tic_tac_toe::Move > const& node )
+MetaTicTacToeTree::MetaTicTacToeTree( GVC_t* gv_gvc, Player player, Minimax< meta_tic_tac_toe::Move > const& minimax )
     : Tree( gv_gvc, player ) 
 {
-    add_node( gv_graph, player, node );
+    std::unordered_map< Vertex< meta_tic_tac_toe::Move > const*, Agnode_t* > added;
+    add_node( gv_graph, player, minimax, minimax.root, added );
     gv_focus_node = agfstnode( gv_graph);
 }
 
@@ -376,7 +385,8 @@ void Tree::set_node_attribute( Agnode_t* gv_node, Player player )
 }
 
 template< typename MoveT >
-Agnode_t* add_node( Agraph_t* gv_graph, Player player, montecarlo::Node< MoveT > const& node )
+Agnode_t* add_node( Agraph_t* gv_graph, Player player, MCTS< MoveT > const& mcts, 
+                    montecarlo::Node< MoveT > const& node )
 {
     Agnode_t* gv_node = agnode(gv_graph, nullptr, true);
 
@@ -384,16 +394,16 @@ Agnode_t* add_node( Agraph_t* gv_graph, Player player, montecarlo::Node< MoveT >
     data->depth = 1;
     data->node = (void*)&node;
 
-    for (montecarlo::Node< MoveT > const& child : node.children)
+    for (montecarlo::Node< MoveT > const& child : mcts.children( node ))
     {
-        Agnode_t* gv_child = add_node( gv_graph, Player( -player ), child );
+        Agnode_t* gv_child = add_node( gv_graph, Player( -player ), mcts, child );
         agedge( gv_graph, gv_node, gv_child, nullptr, true);
 
         Tree::Data* child_data = (Tree::Data*)aggetrec(gv_child, "data", 0);
         if (child_data->depth > data->depth)
             data->depth = child_data->depth;
     }
-    if (!node.children.empty())
+    if (node.child_count)
         ++data->depth;
 
     return gv_node;
@@ -434,7 +444,7 @@ void get_stats( Agraph_t* gv_graph, Agnode_t* gv_node, double exploration, Tree:
 {
     Tree::Data* node_data = (Tree::Data*)aggetrec(gv_node, "data", 0);
     montecarlo::Node< MoveT > const& node = *(montecarlo::Node< MoveT >*)node_data->node;
-    stats.points = node.numerator;
+    stats.points = node.wins();
     stats.playouts = node.denominator;
     montecarlo::Node< MoveT >* parent_node = get_parent_node< MoveT >( gv_graph, gv_node );
     stats.cbt = parent_node ? MCTS< MoveT >::cbt( node, *parent_node, exploration ) : 0.0;
@@ -443,10 +453,10 @@ void get_stats( Agraph_t* gv_graph, Agnode_t* gv_node, double exploration, Tree:
 }
 
 TicTacToeTree::TicTacToeTree( 
-    GVC_t* gv_gvc, Player player, float exploration, montecarlo::Node< tic_tac_toe::Move > const& node ) 
+    GVC_t* gv_gvc, Player player, float exploration, MCTS< tic_tac_toe::Move > const& mcts ) 
     : Tree( gv_gvc, player, exploration ) 
 {
-    add_node( gv_graph, player, node );
+    add_node( gv_graph, player, mcts, mcts.root );
     gv_focus_node = agfstnode( gv_graph);
 }
 
@@ -456,10 +466,10 @@ void TicTacToeTree::get_stats( Agnode_t* gv_node, Tree::Stats& stats )
 }
 
 MetaTicTacToeTree::MetaTicTacToeTree( 
-    GVC_t* gv_gvc, Player player, float exploration, montecarlo::Node< meta_tic_tac_toe::Move > const& node ) 
+    GVC_t* gv_gvc, Player player, float exploration, MCTS< meta_tic_tac_toe::Move > const& mcts ) 
     : Tree( gv_gvc, player, exploration ) 
 {
-    add_node( gv_graph, player, node );
+    add_node( gv_graph, player, mcts, mcts.root );
     gv_focus_node = agfstnode( gv_graph);
 }
 
@@ -135,7 +135,7 @@ private:
 class TicTacToeTree : public Tree
 {
 public:
-    TicTacToeTree( GVC_t* gv_gvc, Player player, Vertex< tic_tac_toe::Move > const& node );
+    TicTacToeTree( GVC_t* gv_gvc, Player player, Minimax< tic_tac_toe::Move > const& minimax );
     ~TicTacToeTree();
 private:
     void get_stats( Agnode_t* gv_node, Stats& move );
@@ -144,7 +144,7 @@ private:
 class MetaTicTacToeTree : public Tree
 {
 public:
-    MetaTicTacToeTree( GVC_t* gv_gvc, Player player, Vertex< meta_tic_tac_toe::Move > const& node );
+    MetaTicTacToeTree( GVC_t* gv_gvc, Player player, Minimax< meta_tic_tac_toe::Move > const& minimax );
     ~MetaTicTacToeTree();
 private:
     void get_stats( Agnode_t* gv_node, Stats& move );
@@ -190,7 +190,7 @@ class TicTacToeTree : public Tree
 {
 public:
     TicTacToeTree( 
-        GVC_t* gv_gvc, Player player, float exploration, montecarlo::Node< tic_tac_toe::Move > const& node );
+        GVC_t* gv_gvc, Player player, float exploration, MCTS< tic_tac_toe::Move > const& mcts );
 private:
     virtual void get_stats( Agnode_t* gv_node, Stats& move );
 };
@@ -199,7 +199,7 @@ class MetaTicTacToeTree : public Tree
 {
 public:
     MetaTicTacToeTree( 
-        GVC_t* gv_gvc, Player player, float exploration, montecarlo::Node< meta_tic_tac_toe::Move > const& node );
+        GVC_t* gv_gvc, Player player, float exploration, MCTS< meta_tic_tac_toe::Move > const& mcts );
 private:
     virtual void get_stats( Agnode_t* gv_node, Stats& move );
 };
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "arena.h"
+
+#include <string>
+#include <fstream>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* persisted search trees. The file starts with a header page holding the
+   format description and the root, followed by the arena blocks exactly as
+   they are in memory. Children are addressed by arena index and not by
+   pointer, so a file is mapped copy-on-write and used in place without any
+   parsing. Items are stored in the native layout, a file is rejected if
+   the item size or the position of the root does not match. */
+struct TreeFileHeader
+{
+    static constexpr char signature[8] = { 'M', 'M', 'T', 'R', 'E', 'E', '\0', '\0' };
+    static constexpr std::uint32_t current_version = 1;
+    // size of the header page, the blocks start page aligned
+    static constexpr size_t page_size = 4096;
+    // offset of the root in the header page
+    static constexpr size_t root_offset = 64;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t item_size;
+    std::uint32_t block_bits;
+    std::uint32_t block_count;
+    std::uint64_t last_used;
+    std::uint64_t allocated;
+    // key of the root position
+    std::uint64_t key;
+};
+
+static_assert (sizeof( TreeFileHeader ) <= TreeFileHeader::root_offset);
+
+// write root and arena to path, return false on error
+template< typename T >
+bool save_tree( std::string const& path, std::uint64_t key, T const& root, Arena< T > const& arena )
+{
+    static_assert (std::is_trivially_copyable_v< T >);
+    static_assert (TreeFileHeader::root_offset + sizeof( T ) <= TreeFileHeader::page_size);
+
+    TreeFileHeader header;
+    std::memcpy( header.magic, TreeFileHeader::signature, sizeof( header.magic ));
+    header.version = TreeFileHeader::current_version;
+    header.item_size = sizeof( T );
+    header.block_bits = Arena< T >::block_bits;
+    header.block_count = std::uint32_t( arena.block_count());
+    header.last_used = arena.last_used();
+    header.allocated = arena.size();
+    header.key = key;
+
+    char page[TreeFileHeader::page_size] = {};
+    std::memcpy( page, &header, sizeof( header ));
+    std::memcpy( page + TreeFileHeader::root_offset, &root, sizeof( T ));
+
+    std::ofstream file( path, std::ios::binary | std::ios::trunc );
+    file.write( page, sizeof( page ));
+    for (size_t idx = 0; idx != arena.block_count(); ++idx)
+    {
+        // only the items in use are accessible, e.g. of a block attached from a file
+        const size_t items = arena.block_used( idx );
+        file.write( (char const*)arena.block( idx ), std::streamsize( items * sizeof( T )));
+        // blocks start at a multiple of the block size, the gap reads as zeros
+        if (idx + 1 != arena.block_count())
+            file.seekp( std::streamoff( (Arena< T >::block_size - items) * sizeof( T )), std::ios::cur );
+    }
+    return bool( file.flush());
+}
+
+/* map the tree saved at path for the position key into root and arena, the
+   arena keeps the mapping alive. Return false if there is no valid file. */
+template< typename T >
+bool load_tree( std::string const& path, std::uint64_t key, T& root, Arena< T >& arena )
+{
+    static_assert (std::is_trivially_copyable_v< T >);
+
+    const int fd = ::open( path.c_str(), O_RDONLY );
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (::fstat( fd, &st ) != 0 || size_t( st.st_size ) < TreeFileHeader::page_size)
+    {
+        ::close( fd );
+        return false;
+    }
+    const size_t length = size_t( st.st_size );
+    // private mapping, the search modifies the tree without writing back
+    void* data = ::mmap( nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+    ::close( fd );
+    if (data == MAP_FAILED)
+        return false;
+    std::shared_ptr< void > mapping( data, [length]( void* data ) { ::munmap( data, length ); });
+
+    TreeFileHeader header;
+    std::memcpy( &header, data, sizeof( header ));
+    const size_t blocks_length = header.block_count
+        ? ((header.block_count - 1) * Arena< T >::block_size + header.last_used) * sizeof( T ) : 0;
+    if (   std::memcmp( header.magic, TreeFileHeader::signature, sizeof( header.magic ))
+        || header.version != TreeFileHeader::current_version
+        || header.item_size != sizeof( T )
+        || header.block_bits != Arena< T >::block_bits
+        || header.key != key
+        || length < TreeFileHeader::page_size + blocks_length)
+        return false;
+
+    char* const page = (char*)data;
+    std::memcpy( &root, page + TreeFileHeader::root_offset, sizeof( T ));
+    arena.attach( (T*)(page + TreeFileHeader::page_size), header.block_count, header.last_used,
+                  header.allocated, mapping );
+    return true;
+}
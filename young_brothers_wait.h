@@ -0,0 +1,351 @@
+#pragma once
+
+#include "negamax.h"
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <functional>
+
+/* thread pool with one deque per worker. The owner pushes and pops tasks at
+   the back, idle workers steal from the front of the other deques. Tasks are
+   executed by a callable receiving the task and the index of the executing
+   worker. */
+template< typename TaskT >
+class WorkStealingPool
+{
+public:
+    WorkStealingPool( size_t workers, std::function< void (TaskT&, size_t) > execute )
+    : queues( workers ), execute( execute ) {}
+
+    void push( TaskT const& task, size_t worker )
+    {
+        Queue& queue = queues[worker];
+        std::lock_guard< std::mutex > lock( queue.mutex );
+        queue.tasks.push_back( task );
+    }
+
+    // run one task of the own deque or steal one, return false if there was none
+    bool run_one( size_t worker )
+    {
+        TaskT task;
+        if (pop( worker, task ))
+        {
+            execute( task, worker );
+            return true;
+        }
+        for (size_t idx = 1; idx != queues.size(); ++idx)
+            if (steal( (worker + idx) % queues.size(), task ))
+            {
+                ++steals;
+                execute( task, worker );
+                return true;
+            }
+        return false;
+    }
+
+    size_t workers() const
+    {
+        return queues.size();
+    }
+
+    std::atomic< size_t > steals = 0;
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque< TaskT > tasks;
+    };
+
+    bool pop( size_t worker, TaskT& task )
+    {
+        Queue& queue = queues[worker];
+        std::lock_guard< std::mutex > lock( queue.mutex );
+        if (queue.tasks.empty())
+            return false;
+        task = queue.tasks.back();
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    bool steal( size_t victim, TaskT& task )
+    {
+        Queue& queue = queues[victim];
+        std::lock_guard< std::mutex > lock( queue.mutex );
+        if (queue.tasks.empty())
+            return false;
+        task = queue.tasks.front();
+        queue.tasks.pop_front();
+        return true;
+    }
+
+    std::vector< Queue > queues;
+    std::function< void (TaskT&, size_t) > execute;
+};
+
+struct YoungBrothersWaitStatistics
+{
+    void clear()
+    {
+        nodes = 0;
+        splits = 0;
+        tasks = 0;
+        aborted_tasks = 0;
+        steals = 0;
+    }
+
+    std::atomic< size_t > nodes = 0;
+    std::atomic< size_t > splits = 0;
+    std::atomic< size_t > tasks = 0;
+    std::atomic< size_t > aborted_tasks = 0;
+    std::atomic< size_t > steals = 0;
+};
+
+/* young brothers wait parallel negamax. At each node the eldest child is
+   searched first, if the node is not cut off by it and the remaining depth
+   is at least min_split_depth, the younger brothers are pushed as tasks to
+   the work stealing pool. Tasks clone the rule of their split point and share
+   its alpha bound, a cutoff stops all tasks below the split point. The
+   waiting thread helps executing tasks. */
+template< typename MoveT >
+struct YoungBrothersWait
+{
+    struct SplitPoint
+    {
+        GenericRule< MoveT > const* rule;
+        SplitPoint const* parent;
+        Player player;
+        size_t depth;
+        size_t ply;
+        double beta;
+
+        std::mutex mutex;
+        double value;
+        std::optional< MoveT > best_move;
+        std::atomic< double > alpha;
+        std::atomic< bool > cutoff = false;
+        std::atomic< size_t > pending = 0;
+
+        // true if this or any parent split point is cut off
+        bool is_cut_off() const
+        {
+            for (SplitPoint const* sp = this; sp; sp = sp->parent)
+                if (sp->cutoff)
+                    return true;
+            return false;
+        }
+    };
+
+    struct Task
+    {
+        SplitPoint* sp = nullptr;
+        MoveT move = MoveT();
+    };
+
+    // a cache line of its own, the node count is written at every node
+    struct alignas( 64 ) Worker
+    {
+        std::vector< MoveT > moves;
+        ReorderByHistory< MoveT > history;
+        size_t nodes = 0;
+    };
+
+    YoungBrothersWait( Negamax< MoveT >& main, size_t threads, size_t min_split_depth )
+    : main( main ), min_split_depth( min_split_depth ), workers( std::max< size_t >( threads, 1 )),
+      pool( workers.size(), [this](Task& task, size_t worker) { execute( task, worker ); }) {}
+
+    /* search the position of the main negamax, the main thread is worker 0.
+       stop is reset by the caller when it launches the search, so a stop
+       arriving before the search runs is not lost. */
+    double operator()( size_t depth, Player player )
+    {
+        // the statistics are reported per search
+        statistics.clear();
+        done = false;
+        best_move.reset();
+        const size_t steals = pool.steals;
+
+        std::vector< std::thread > threads;
+        for (size_t idx = 1; idx < workers.size(); ++idx)
+            threads.emplace_back( [this, idx]()
+            {
+                while (!done)
+                    if (!pool.run_one( idx ))
+                        std::this_thread::yield();
+            });
+
+        for (Worker& worker : workers)
+            worker.history.age();
+
+        const double value = rec(
+            *main.rule, 0, depth, player2_won, player1_won, player, 0, nullptr, &best_move );
+
+        done = true;
+        for (auto& thread : threads)
+            thread.join();
+        statistics.steals += pool.steals - steals;
+        for (Worker& worker : workers)
+        {
+            statistics.nodes += worker.nodes;
+            worker.nodes = 0;
+        }
+
+        return value;
+    }
+
+    double rec( GenericRule< MoveT >& rule, size_t worker_idx, size_t depth, double alpha, double beta,
+                Player player, size_t ply, SplitPoint const* parent, std::optional< MoveT >* best )
+    {
+        ++workers[worker_idx].nodes;
+
+        if (stop || (parent && parent->is_cut_off()))
+            return 0.0;
+
+        const Player winner = rule.get_winner();
+        if (winner != not_set)
+            return player * winner * player1_won;
+
+        Worker& worker = workers[worker_idx];
+        const size_t prev_size = worker.moves.size();
+        {
+            auto& tmp = rule.generate_moves();
+            worker.moves.insert( worker.moves.end(), tmp.begin(), tmp.end());
+        }
+        const size_t new_size = worker.moves.size();
+
+        if (prev_size == new_size)
+            return 0.0;
+
+        if (!depth)
+        {
+            worker.moves.resize( prev_size );
+            return player * main.eval( rule, player );
+        }
+
+        // the previous move is not tracked per task, order by killers and history only
+        worker.history.set_node( ply, std::nullopt );
+        worker.history( rule, player, worker.moves.begin() + prev_size, worker.moves.end());
+
+        // eldest brother first
+        const MoveT eldest = worker.moves[prev_size];
+        rule.apply_move( eldest, player );
+        double value = -rec( rule, worker_idx, depth - 1, -beta, -alpha, Player( -player ), ply + 1,
+                             parent, nullptr );
+        rule.undo_move( eldest, player );
+        std::optional< MoveT > best_move = eldest;
+        alpha = std::max( alpha, value );
+
+        if (stop || (parent && parent->is_cut_off()))
+        {
+            worker.moves.resize( prev_size );
+            return 0.0;
+        }
+
+        if (alpha >= beta)
+            worker.history.cutoff( eldest, player, depth, ply, std::nullopt );
+        else if (depth >= min_split_depth && new_size - prev_size > 1)
+        {
+            SplitPoint sp;
+            sp.rule = &rule;
+            sp.parent = parent;
+            sp.player = player;
+            sp.depth = depth;
+            sp.ply = ply;
+            sp.beta = beta;
+            sp.value = value;
+            sp.best_move = best_move;
+            sp.alpha = alpha;
+            sp.pending = new_size - prev_size - 1;
+
+            ++statistics.splits;
+            for (size_t idx = prev_size + 1; idx != new_size; ++idx)
+                pool.push( Task { &sp, worker.moves[idx] }, worker_idx );
+
+            // help while waiting for the younger brothers
+            while (sp.pending)
+                if (!pool.run_one( worker_idx ))
+                    std::this_thread::yield();
+
+            value = sp.value;
+            best_move = sp.best_move;
+        }
+        else
+            for (size_t idx = prev_size + 1; idx != new_size; ++idx)
+            {
+                const MoveT move = worker.moves[idx];
+                rule.apply_move( move, player );
+                const double new_value = -rec( rule, worker_idx, depth - 1, -beta, -alpha, Player( -player ),
+                                               ply + 1, parent, nullptr );
+                rule.undo_move( move, player );
+
+                if (new_value > value)
+                {
+                    value = new_value;
+                    best_move = move;
+                }
+                alpha = std::max( alpha, value );
+                if (alpha >= beta)
+                {
+                    worker.history.cutoff( move, player, depth, ply, std::nullopt );
+                    break;
+                }
+            }
+
+        // the worker may have executed tasks in between, its moves are stacked on top
+        worker.moves.resize( prev_size );
+
+        if (best)
+            *best = best_move;
+        return value;
+    }
+
+    void execute( Task& task, size_t worker_idx )
+    {
+        SplitPoint& sp = *task.sp;
+        ++statistics.tasks;
+
+        if (stop || sp.is_cut_off())
+            ++statistics.aborted_tasks;
+        else
+        {
+            std::unique_ptr< GenericRule< MoveT > > rule( sp.rule->clone());
+            rule->apply_move( task.move, sp.player );
+            const double new_value = -rec(
+                *rule, worker_idx, sp.depth - 1, -sp.beta, -sp.alpha, Player( -sp.player ), sp.ply + 1,
+                &sp, nullptr );
+
+            // discard results of aborted searches
+            if (stop || sp.is_cut_off())
+                ++statistics.aborted_tasks;
+            else
+            {
+                std::lock_guard< std::mutex > lock( sp.mutex );
+                if (new_value > sp.value)
+                {
+                    sp.value = new_value;
+                    sp.best_move = task.move;
+                }
+                if (sp.value > sp.alpha)
+                    sp.alpha = sp.value;
+                if (sp.alpha >= sp.beta)
+                {
+                    workers[worker_idx].history.cutoff( task.move, sp.player, sp.depth, sp.ply, std::nullopt );
+                    sp.cutoff = true;
+                }
+            }
+        }
+
+        --sp.pending;
+    }
+
+    Negamax< MoveT >& main;
+    const size_t min_split_depth;
+    std::vector< Worker > workers;
+    WorkStealingPool< Task > pool;
+    YoungBrothersWaitStatistics statistics;
+    std::optional< MoveT > best_move;
+    std::atomic< bool > stop = false;
+    std::atomic< bool > done = false;
+};